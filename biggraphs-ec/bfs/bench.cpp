@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "../common/CycleTimer.h"
+#include "../common/graph.h"
+#include "bfs.h"
+
+// Graph500-style benchmark: every BFS variant is run from the same
+// random non-isolated roots, its parent tree is validated, and the
+// traversed edges per second (TEPS) are summarized as CSV.
+
+#define DEFAULT_NUM_ROOTS 64
+#define DEFAULT_SEED 149
+
+struct bfs_variant {
+    const char* name;
+    void (*run)(Graph, solution*, Vertex, bfs_workspace*);
+};
+
+void usage(const char* binary_name) {
+    std::cout << "Usage: " << binary_name << " [options] graphfile" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -r  INT number of roots (default " << DEFAULT_NUM_ROOTS << ")" << std::endl;
+    std::cout << "  -s  INT random seed for root selection (default " << DEFAULT_SEED << ")" << std::endl;
+    std::cout << "  -n  INT number of threads (default: 1, 2, 4, ... max)" << std::endl;
+    std::cout << "  -h      this commandline help message" << std::endl;
+}
+
+// Distinct roots with at least one outgoing edge, as in Graph500.
+std::vector<Vertex> sample_roots(Graph g, int num_roots, unsigned int seed) {
+    int candidates = 0;
+    for (int v = 0; v < g->num_nodes; v++)
+        if (outgoing_size(g, v) > 0)
+            candidates++;
+    num_roots = std::min(num_roots, candidates);
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pick(0, g->num_nodes - 1);
+    std::set<Vertex> chosen;
+    std::vector<Vertex> roots;
+    while ((int)roots.size() < num_roots) {
+        Vertex v = pick(rng);
+        if (outgoing_size(g, v) > 0 && chosen.insert(v).second)
+            roots.push_back(v);
+    }
+    return roots;
+}
+
+// Checks the search from root against the Graph500 rules for a
+// directed graph: the tree is rooted at root, every tree edge is a
+// graph edge going down exactly one level, and no graph edge leaving a
+// reached vertex skips a level or leads to an unreached vertex.
+bool validate_bfs_tree(Graph g, Vertex root, const int* distances, const int* parents) {
+
+    if (parents[root] != root || distances[root] != 0) {
+        std::cerr << "*** Root " << root << " is not the root of its tree" << std::endl;
+        return false;
+    }
+
+    bool valid = true;
+
+    #pragma omp parallel for schedule(dynamic, 512) reduction(&&:valid)
+    for (int v = 0; v < g->num_nodes; v++) {
+        if (distances[v] == -1) {
+            if (parents[v] != -1) valid = false;
+            continue;
+        }
+
+        if (v != root) {
+            Vertex p = parents[v];
+            if (p < 0 || p >= g->num_nodes || distances[p] != distances[v] - 1) {
+                valid = false;
+                continue;
+            }
+            bool edge_found = false;
+            for (const Vertex* u = incoming_begin(g, v); u != incoming_end(g, v); u++) {
+                if (*u == p) {
+                    edge_found = true;
+                    break;
+                }
+            }
+            if (!edge_found) valid = false;
+        }
+
+        for (const Vertex* u = outgoing_begin(g, v); u != outgoing_end(g, v); u++) {
+            if (distances[*u] == -1 || distances[*u] > distances[v] + 1)
+                valid = false;
+        }
+    }
+
+    if (!valid)
+        std::cerr << "*** BFS tree from root " << root << " failed validation" << std::endl;
+    return valid;
+}
+
+// Graph500 counts the edges of the traversed component: here, the
+// outgoing edges of every reached vertex.
+long traversed_edges(Graph g, const int* distances) {
+    long edges = 0;
+    #pragma omp parallel for reduction(+:edges)
+    for (int v = 0; v < g->num_nodes; v++)
+        if (distances[v] != -1)
+            edges += outgoing_size(g, v);
+    return edges;
+}
+
+int main(int argc, char** argv) {
+    int num_roots = DEFAULT_NUM_ROOTS;
+    unsigned int seed = DEFAULT_SEED;
+    int thread_count = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:n:h")) != EOF) {
+        switch (opt) {
+            case 'r':
+                num_roots = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 'n':
+                thread_count = atoi(optarg);
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (argc <= optind) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    std::string graph_filename = argv[optind];
+    std::string graph_name = graph_filename.substr(graph_filename.find_last_of('/') + 1);
+
+    Graph g = load_graph_binary(graph_filename.c_str());
+    std::vector<Vertex> roots = sample_roots(g, num_roots, seed);
+    if (roots.empty()) {
+        std::cerr << "Graph has no vertex with outgoing edges." << std::endl;
+        exit(1);
+    }
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    bfs_variant variants[] = {
+        { "top_down", bfs_top_down },
+        { "bottom_up", bfs_bottom_up },
+        { "hybrid", bfs_hybrid },
+    };
+
+    solution sol;
+    sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+    int* parents = (int*)malloc(sizeof(int) * g->num_nodes);
+    bfs_workspace ws;
+    bfs_workspace_init(&ws, g->num_nodes);
+
+    std::cout << "graph,variant,threads,roots,min_teps,median_teps,max_teps,harmonic_mean_teps,valid" << std::endl;
+
+    for (const bfs_variant& variant : variants) {
+        for (int threads : num_threads) {
+            omp_set_num_threads(threads);
+
+            std::vector<double> teps;
+            bool valid = true;
+
+            for (Vertex root : roots) {
+                // the timed kernel is the search plus building its parent array
+                double start = CycleTimer::currentSeconds();
+                variant.run(g, &sol, root, &ws);
+                bfs_parents(g, sol.distances, parents);
+                double time = CycleTimer::currentSeconds() - start;
+
+                valid = validate_bfs_tree(g, root, sol.distances, parents) && valid;
+                teps.push_back(traversed_edges(g, sol.distances) / time);
+            }
+
+            std::sort(teps.begin(), teps.end());
+            size_t mid = teps.size() / 2;
+            double median = (teps.size() % 2) ? teps[mid] : 0.5 * (teps[mid - 1] + teps[mid]);
+            double inverse_sum = 0;
+            for (double t : teps)
+                inverse_sum += 1.0 / t;
+
+            printf("%s,%s,%d,%d,%.6e,%.6e,%.6e,%.6e,%s\n",
+                   graph_name.c_str(), variant.name, threads, (int)teps.size(),
+                   teps.front(), median, teps.back(), teps.size() / inverse_sum,
+                   valid ? "true" : "false");
+            fflush(stdout);
+        }
+    }
+
+    bfs_workspace_free(&ws);
+    free(parents);
+    free(sol.distances);
+    free_graph(g);
+
+    return 0;
+}
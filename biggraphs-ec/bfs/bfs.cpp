@@ -8,11 +8,13 @@
 #include <vector>
 #include <cstring> 
 #include <memory>
+#include <algorithm>
+#include <stdint.h>
 
 #include "../common/CycleTimer.h"
 #include "../common/graph.h"
+#include "../common/perf_counters.h"
 
-#define ROOT_NODE_ID 0
 #define NOT_VISITED_MARKER -1
 
 void vertex_set_clear(vertex_set* list) {
@@ -30,6 +32,176 @@ void vertex_set_free(vertex_set* list) {
     list->vertices = NULL;
 }
 
+void bfs_workspace_init(bfs_workspace* ws, int num_nodes) {
+    vertex_set_init(&ws->frontier, num_nodes);
+    vertex_set_init(&ws->new_frontier, num_nodes);
+    ws->num_threads = 0;
+    ws->local_buffers = NULL;
+    ws->profile = NULL;
+}
+
+void bfs_workspace_free(bfs_workspace* ws) {
+    vertex_set_free(&ws->frontier);
+    vertex_set_free(&ws->new_frontier);
+    free(ws->local_buffers);
+    ws->local_buffers = NULL;
+}
+
+// Makes room for a local buffer per thread of the next parallel region
+// and empties both frontiers.  Buffers only grow, so after the first
+// search at the highest thread count nothing is allocated any more.
+static void bfs_workspace_prepare(bfs_workspace* ws) {
+    int num_threads = omp_get_max_threads();
+    if (num_threads > ws->num_threads) {
+        free(ws->local_buffers);
+        ws->local_buffers = (Vertex*)malloc(sizeof(Vertex) * BFS_LOCAL_BUFFER_SIZE * num_threads);
+        ws->num_threads = num_threads;
+    }
+    vertex_set_clear(&ws->frontier);
+    vertex_set_clear(&ws->new_frontier);
+}
+
+// Copies a thread's buffered vertices into the shared new frontier,
+// reserving the space with one atomic add.
+static inline void local_buffer_flush(vertex_set* new_frontier, Vertex* buffer, int* buffer_size) {
+    int index = __sync_fetch_and_add(&new_frontier->count, *buffer_size);
+    memcpy(new_frontier->vertices + index, buffer, *buffer_size * sizeof(Vertex));
+    *buffer_size = 0;
+}
+
+static inline void local_buffer_push(vertex_set* new_frontier, Vertex* buffer, int* buffer_size, Vertex v) {
+    buffer[(*buffer_size)++] = v;
+    if (*buffer_size == BFS_LOCAL_BUFFER_SIZE)
+        local_buffer_flush(new_frontier, buffer, buffer_size);
+}
+
+// Instrumentation of one search; every call is a no-op unless the
+// workspace has a profile.  Counters are read around each step only,
+// and the edges examined are counted afterwards, outside the
+// measurement, from the distances the step left behind.
+struct level_probe {
+    bfs_profile* profile;
+    const char* variant;
+    perf_counters counters;
+    long long before[PERF_NUM_COUNTERS];
+    double start_time;
+    int level;
+};
+
+static void probe_begin_search(level_probe* probe, bfs_workspace* ws, const char* variant) {
+    probe->profile = ws->profile;
+    if (!probe->profile)
+        return;
+    probe->variant = variant;
+    probe->level = 0;
+    perf_counters_open(&probe->counters);
+
+    if (!probe->profile->header_written) {
+        fprintf(probe->profile->out, "variant,threads,level,direction,frontier,edges_examined,seconds");
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++)
+            fprintf(probe->profile->out, ",%s", perf_counter_names[c]);
+        fprintf(probe->profile->out, ",mem_bytes_est\n");
+        probe->profile->header_written = true;
+    }
+}
+
+static inline void probe_begin_level(level_probe* probe) {
+    if (!probe->profile)
+        return;
+    perf_counters_read(&probe->counters, probe->before);
+    probe->start_time = CycleTimer::currentSeconds();
+}
+
+// count_edges() is only called when profiling.
+template <typename EdgeCounter>
+static inline void probe_end_level(level_probe* probe, const char* direction, int frontier_size,
+                                   EdgeCounter count_edges) {
+    if (!probe->profile)
+        return;
+    double seconds = CycleTimer::currentSeconds() - probe->start_time;
+    long long after[PERF_NUM_COUNTERS];
+    perf_counters_read(&probe->counters, after);
+
+    FILE* out = probe->profile->out;
+    fprintf(out, "%s,%d,%d,%s,%d,%ld,%.9f", probe->variant, omp_get_max_threads(), probe->level,
+            direction, frontier_size, count_edges(), seconds);
+    long long delta[PERF_NUM_COUNTERS];
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        delta[c] = (after[c] < 0 || probe->before[c] < 0) ? -1 : after[c] - probe->before[c];
+        fprintf(out, ",%lld", delta[c]);
+    }
+    // approximate: every last-level miss fetches one line from DRAM
+    fprintf(out, ",%lld\n", delta[PERF_LLC_MISSES] < 0 ? -1 : delta[PERF_LLC_MISSES] * PERF_CACHE_LINE_BYTES);
+    probe->level++;
+}
+
+static void probe_end_search(level_probe* probe) {
+    if (!probe->profile)
+        return;
+    perf_counters_close(&probe->counters);
+    fflush(probe->profile->out);
+}
+
+// Edges a top-down step reads: every outgoing edge of the frontier.
+static long top_down_edges(Graph g, const vertex_set* frontier) {
+    long edges = 0;
+    #pragma omp parallel for reduction(+:edges)
+    for (int i = 0; i < frontier->count; i++)
+        edges += outgoing_size(g, frontier->vertices[i]);
+    return edges;
+}
+
+// Edges a bottom-up step reads: vertices still unvisited scanned all
+// their incoming edges, vertices reached in the step stopped at their
+// first incoming neighbor on the frontier.
+static long bottom_up_edges(Graph g, const int* distances, int currentLevel, int nextLevel) {
+    long edges = 0;
+    #pragma omp parallel for schedule(dynamic, 512) reduction(+:edges)
+    for (int v = 0; v < g->num_nodes; v++) {
+        if (distances[v] == NOT_VISITED_MARKER) {
+            edges += incoming_size(g, v);
+        } else if (distances[v] == nextLevel) {
+            for (const Vertex* u = incoming_begin(g, v), *end = incoming_end(g, v); u < end; ++u) {
+                edges++;
+                if (distances[*u] == currentLevel)
+                    break;
+            }
+        }
+    }
+    return edges;
+}
+
+static long top_down_edges_compressed(CompressedGraph g, const vertex_set* frontier) {
+    long edges = 0;
+    #pragma omp parallel for schedule(dynamic, 512) reduction(+:edges)
+    for (int i = 0; i < frontier->count; i++) {
+        neighbor_decoder d;
+        outgoing_decoder(&d, g, frontier->vertices[i]);
+        Vertex x;
+        while (decoder_next(&d, &x))
+            edges++;
+    }
+    return edges;
+}
+
+static long bottom_up_edges_compressed(CompressedGraph g, const int* distances, int currentLevel, int nextLevel) {
+    long edges = 0;
+    #pragma omp parallel for schedule(dynamic, 512) reduction(+:edges)
+    for (int v = 0; v < g->num_nodes; v++) {
+        if (distances[v] != NOT_VISITED_MARKER && distances[v] != nextLevel)
+            continue;
+        neighbor_decoder d;
+        incoming_decoder(&d, g, v);
+        Vertex u;
+        while (decoder_next(&d, &u)) {
+            edges++;
+            if (distances[v] == nextLevel && distances[u] == currentLevel)
+                break;
+        }
+    }
+    return edges;
+}
+
 // Take one step of "top-down" BFS.  For each vertex on the frontier,
 // follow all outgoing edges, and add all neighboring vertices to the
 // new_frontier.
@@ -200,10 +372,10 @@ void top_down_step2(Graph g, vertex_set* frontier, vertex_set* new_frontier,
     } 
 }
 
-void top_down_step3(Graph g, vertex_set* frontier, vertex_set* new_frontier, int* distances, int level) {
+void top_down_step3(Graph g, vertex_set* frontier, vertex_set* new_frontier, int* distances, int level, Vertex* local_buffers) {
 #pragma omp parallel 
 {
-    std::unique_ptr<Vertex[]> buffer(new Vertex[g->num_nodes]);
+    Vertex* buffer = local_buffers + omp_get_thread_num() * BFS_LOCAL_BUFFER_SIZE;
     int buffer_size = 0;
 
     #pragma omp for schedule(dynamic, 512)
@@ -216,12 +388,11 @@ void top_down_step3(Graph g, vertex_set* frontier, vertex_set* new_frontier, int
             // }
             if (distances[*x] == NOT_VISITED_MARKER) { // This has comparable speed as the compare_and_swap above
                 distances[*x] = level;
-                buffer[buffer_size++] = *x;
+                local_buffer_push(new_frontier, buffer, &buffer_size, *x);
             }
         }
     }
-    int index = __sync_fetch_and_add(&new_frontier->count, buffer_size);
-    std::memcpy(new_frontier->vertices + index, buffer.get(), buffer_size * sizeof(Vertex));
+    local_buffer_flush(new_frontier, buffer, &buffer_size);
 }
 }
 
@@ -229,16 +400,18 @@ void top_down_step3(Graph g, vertex_set* frontier, vertex_set* new_frontier, int
 // Implements top-down BFS.
 //
 // Result of execution is that, for each node in the graph, the
-// distance to the root is stored in sol.distances.
-void bfs_top_down(Graph graph, solution* sol) {
+// distance to root is stored in sol.distances.
+void bfs_top_down(Graph graph, solution* sol, Vertex root, bfs_workspace* ws) {
 
-    vertex_set list1;
-    vertex_set list2;
-    vertex_set_init(&list1, graph->num_nodes);
-    vertex_set_init(&list2, graph->num_nodes);
+    bfs_workspace temp_ws;
+    if (ws == NULL) {
+        bfs_workspace_init(&temp_ws, graph->num_nodes);
+        ws = &temp_ws;
+    }
+    bfs_workspace_prepare(ws);
 
-    vertex_set* frontier = &list1;
-    vertex_set* new_frontier = &list2;
+    vertex_set* frontier = &ws->frontier;
+    vertex_set* new_frontier = &ws->new_frontier;
 
     // initialize all nodes to NOT_VISITED
     #pragma omp parallel for
@@ -246,8 +419,11 @@ void bfs_top_down(Graph graph, solution* sol) {
         sol->distances[i] = NOT_VISITED_MARKER;
 
     // setup frontier with the root node
-    frontier->vertices[frontier->count++] = ROOT_NODE_ID;
-    sol->distances[ROOT_NODE_ID] = 0;
+    frontier->vertices[frontier->count++] = root;
+    sol->distances[root] = 0;
+
+    level_probe probe;
+    probe_begin_search(&probe, ws, "top_down");
 
     int level = 1;
     while (frontier->count != 0) {
@@ -257,12 +433,15 @@ void bfs_top_down(Graph graph, solution* sol) {
 #endif
 
         vertex_set_clear(new_frontier);
+        probe_begin_level(&probe);
 
         // top_down_step(graph, frontier, new_frontier, sol->distances);
         // top_down_step_parallelize(graph, frontier, new_frontier, sol->distances);
         // top_down_step2(graph, frontier, new_frontier, sol->distances);
-        top_down_step3(graph, frontier, new_frontier, sol->distances, level);
+        top_down_step3(graph, frontier, new_frontier, sol->distances, level, ws->local_buffers);
         // top_down_step_parallelize1(graph, frontier, new_frontier, sol->distances);
+        probe_end_level(&probe, "top_down", frontier->count,
+                        [&] { return top_down_edges(graph, frontier); });
         level++;
 
 
@@ -277,17 +456,18 @@ void bfs_top_down(Graph graph, solution* sol) {
         new_frontier = tmp;
     }
 
-    vertex_set_free(&list1);
-    vertex_set_free(&list2);
+    probe_end_search(&probe);
+
+    if (ws == &temp_ws)
+        bfs_workspace_free(&temp_ws);
 }
 
 
-void bottomUpParallel(Graph g, vertex_set* frontier, vertex_set* new_frontier, int* distances, int currentLevel, int nextLevel)  
+void bottomUpParallel(Graph g, vertex_set* frontier, vertex_set* new_frontier, int* distances, int currentLevel, int nextLevel, Vertex* local_buffers)  
 {
 #pragma omp parallel
 {   
-    // printf("Enter bottomUp");
-    Vertex* buffer = new Vertex[g->num_nodes];
+    Vertex* buffer = local_buffers + omp_get_thread_num() * BFS_LOCAL_BUFFER_SIZE;
     int buffer_size = 0;
     
     #pragma omp for schedule(dynamic, 512)
@@ -297,24 +477,20 @@ void bottomUpParallel(Graph g, vertex_set* frontier, vertex_set* new_frontier, i
         for (const Vertex* u = incoming_begin(g, v), *end = incoming_end(g, v); u < end; ++u) {
             if (distances[*u] == currentLevel) {
                 distances[v] = nextLevel;
-                buffer[buffer_size++] = v;
+                local_buffer_push(new_frontier, buffer, &buffer_size, v);
                 break;
             }
         }
         
     }
 
-    int index = __sync_fetch_and_add(&new_frontier->count, buffer_size);
-    // printf("Reach memcpy");
-    memcpy(new_frontier->vertices + index, buffer, buffer_size * sizeof(Vertex));
-    // printf("after memcpy");
-    delete[] buffer;
+    local_buffer_flush(new_frontier, buffer, &buffer_size);
 }
 
 }
 
 
-void bfs_bottom_up(Graph graph, solution* sol)
+void bfs_bottom_up(Graph graph, solution* sol, Vertex root, bfs_workspace* ws)
 {
     // CS149 students:
     //
@@ -327,28 +503,36 @@ void bfs_bottom_up(Graph graph, solution* sol)
     // As was done in the top-down case, you may wish to organize your
     // code by creating subroutine bottom_up_step() that is called in
     // each step of the BFS process.
-    vertex_set list1;
-    vertex_set list2;
-    
-    vertex_set_init(&list1, graph->num_nodes);
-    vertex_set_init(&list2, graph->num_nodes); //Here i did &list1, graph->num_nodes, which means I set init list1 twice and did not initialize list2, causing seg fault
+    bfs_workspace temp_ws;
+    if (ws == NULL) {
+        bfs_workspace_init(&temp_ws, graph->num_nodes);
+        ws = &temp_ws;
+    }
+    bfs_workspace_prepare(ws);
 
-    vertex_set* frontier = &list1;
-    vertex_set* new_frontier = &list2;
+    vertex_set* frontier = &ws->frontier;
+    vertex_set* new_frontier = &ws->new_frontier;
 
     #pragma omp parallel for
     for (int i=0; i < graph->num_nodes; i++)
         sol->distances[i] = NOT_VISITED_MARKER;
 
-    frontier->vertices[frontier->count++] = ROOT_NODE_ID;
-    sol->distances[ROOT_NODE_ID] = 0;
+    frontier->vertices[frontier->count++] = root;
+    sol->distances[root] = 0;
+
+    level_probe probe;
+    probe_begin_search(&probe, ws, "bottom_up");
 
     int currentLevel = 0;
     int nextLevel = 1;
     while (frontier->count != 0) {
         vertex_set_clear(new_frontier);
+        probe_begin_level(&probe);
+
+        bottomUpParallel(graph, frontier, new_frontier, sol->distances, currentLevel, nextLevel, ws->local_buffers);
 
-        bottomUpParallel(graph, frontier, new_frontier, sol->distances, currentLevel, nextLevel);
+        probe_end_level(&probe, "bottom_up", frontier->count,
+                        [&] { return bottom_up_edges(graph, sol->distances, currentLevel, nextLevel); });
 
         vertex_set* temp = frontier;
         frontier = new_frontier;
@@ -357,47 +541,58 @@ void bfs_bottom_up(Graph graph, solution* sol)
         nextLevel++;
     }
 
-    vertex_set_free(&list1);
-    vertex_set_free(&list2);
+    probe_end_search(&probe);
+
+    if (ws == &temp_ws)
+        bfs_workspace_free(&temp_ws);
 }
 
 
 
-void bfs_hybrid(Graph graph, solution* sol)
+void bfs_hybrid(Graph graph, solution* sol, Vertex root, bfs_workspace* ws)
 {
     // CS149 students:
     //
     // You will need to implement the "hybrid" BFS here as
     // described in the handout.
 
-    vertex_set list1;
-    vertex_set list2;
-    
-    vertex_set_init(&list1, graph->num_nodes);
-    vertex_set_init(&list2, graph->num_nodes);
+    bfs_workspace temp_ws;
+    if (ws == NULL) {
+        bfs_workspace_init(&temp_ws, graph->num_nodes);
+        ws = &temp_ws;
+    }
+    bfs_workspace_prepare(ws);
+
+    vertex_set* frontier = &ws->frontier;
+    vertex_set* new_frontier = &ws->new_frontier;
 
-    vertex_set* frontier = &list1;
-    vertex_set* new_frontier = &list2;
-    
     int totalNodes = graph->num_nodes;
 
     #pragma omp parallel for
     for (int i=0; i < totalNodes; i++)
         sol->distances[i] = NOT_VISITED_MARKER;
 
-    frontier->vertices[frontier->count++] = ROOT_NODE_ID;
-    sol->distances[ROOT_NODE_ID] = 0;
+    frontier->vertices[frontier->count++] = root;
+    sol->distances[root] = 0;
+
+    level_probe probe;
+    probe_begin_search(&probe, ws, "hybrid");
 
     int currentLevel = 0;
     int nextLevel = 1;
     while (frontier->count != 0) {
         vertex_set_clear(new_frontier);
+        probe_begin_level(&probe);
 
         if (frontier->count < 0.05 * totalNodes) {
-            top_down_step3(graph, frontier, new_frontier, sol->distances, nextLevel);
+            top_down_step3(graph, frontier, new_frontier, sol->distances, nextLevel, ws->local_buffers);
+            probe_end_level(&probe, "top_down", frontier->count,
+                            [&] { return top_down_edges(graph, frontier); });
         }
         else {
-            bottomUpParallel(graph, frontier, new_frontier, sol->distances, currentLevel, nextLevel);
+            bottomUpParallel(graph, frontier, new_frontier, sol->distances, currentLevel, nextLevel, ws->local_buffers);
+            probe_end_level(&probe, "bottom_up", frontier->count,
+                            [&] { return bottom_up_edges(graph, sol->distances, currentLevel, nextLevel); });
         }
         
         vertex_set* temp = frontier;
@@ -407,6 +602,240 @@ void bfs_hybrid(Graph graph, solution* sol)
         nextLevel++;
     }
 
-    vertex_set_free(&list1);
-    vertex_set_free(&list2);
+    probe_end_search(&probe);
+
+    if (ws == &temp_ws)
+        bfs_workspace_free(&temp_ws);
+}
+
+
+// Any incoming neighbor one level closer to the root is a valid parent,
+// so the tree can be read off the distances in one pull over the graph.
+void bfs_parents(Graph graph, const int* distances, int* parents)
+{
+    #pragma omp parallel for schedule(dynamic, 512)
+    for (int v = 0; v < graph->num_nodes; v++) {
+        parents[v] = NOT_VISITED_MARKER;
+        if (distances[v] == 0) {
+            parents[v] = v;
+            continue;
+        }
+        if (distances[v] == NOT_VISITED_MARKER) continue;
+
+        for (const Vertex* u = incoming_begin(graph, v), *end = incoming_end(graph, v); u < end; ++u) {
+            if (distances[*u] == distances[v] - 1) {
+                parents[v] = *u;
+                break;
+            }
+        }
+    }
+}
+
+// top_down_step3 over a compressed graph: neighbors are decoded one at
+// a time straight from the varint stream.
+void top_down_step3_compressed(CompressedGraph g, vertex_set* frontier, vertex_set* new_frontier, int* distances, int level, Vertex* local_buffers) {
+#pragma omp parallel
+{
+    Vertex* buffer = local_buffers + omp_get_thread_num() * BFS_LOCAL_BUFFER_SIZE;
+    int buffer_size = 0;
+
+    #pragma omp for schedule(dynamic, 512)
+    for (int i = 0; i < frontier->count; i++) {
+
+        neighbor_decoder d;
+        outgoing_decoder(&d, g, frontier->vertices[i]);
+        Vertex x;
+        while (decoder_next(&d, &x)) {
+            if (distances[x] == NOT_VISITED_MARKER) {
+                distances[x] = level;
+                local_buffer_push(new_frontier, buffer, &buffer_size, x);
+            }
+        }
+    }
+    local_buffer_flush(new_frontier, buffer, &buffer_size);
+}
+}
+
+// bottomUpParallel over a compressed graph.  Decoding stops at the
+// first parent found, so most of a long incoming list is never read.
+void bottomUpParallel_compressed(CompressedGraph g, vertex_set* new_frontier, int* distances, int currentLevel, int nextLevel, Vertex* local_buffers)
+{
+#pragma omp parallel
+{
+    Vertex* buffer = local_buffers + omp_get_thread_num() * BFS_LOCAL_BUFFER_SIZE;
+    int buffer_size = 0;
+
+    #pragma omp for schedule(dynamic, 512)
+    for (int v = 0; v < g->num_nodes; v++) {
+        if (distances[v] != NOT_VISITED_MARKER) {continue;}
+
+        neighbor_decoder d;
+        incoming_decoder(&d, g, v);
+        Vertex u;
+        while (decoder_next(&d, &u)) {
+            if (distances[u] == currentLevel) {
+                distances[v] = nextLevel;
+                local_buffer_push(new_frontier, buffer, &buffer_size, v);
+                break;
+            }
+        }
+    }
+
+    local_buffer_flush(new_frontier, buffer, &buffer_size);
+}
+}
+
+// Shared driver for the compressed searches.  top_down_threshold is the
+// fraction of vertices below which a frontier is expanded top-down:
+// 1 gives a pure top-down search, 0 a pure bottom-up one.
+void bfs_compressed(CompressedGraph graph, solution* sol, Vertex root, bfs_workspace* ws, double top_down_threshold,
+                    const char* variant)
+{
+    bfs_workspace temp_ws;
+    if (ws == NULL) {
+        bfs_workspace_init(&temp_ws, graph->num_nodes);
+        ws = &temp_ws;
+    }
+    bfs_workspace_prepare(ws);
+
+    vertex_set* frontier = &ws->frontier;
+    vertex_set* new_frontier = &ws->new_frontier;
+
+    #pragma omp parallel for
+    for (int i=0; i < graph->num_nodes; i++)
+        sol->distances[i] = NOT_VISITED_MARKER;
+
+    frontier->vertices[frontier->count++] = root;
+    sol->distances[root] = 0;
+
+    level_probe probe;
+    probe_begin_search(&probe, ws, variant);
+
+    int currentLevel = 0;
+    int nextLevel = 1;
+    while (frontier->count != 0) {
+        vertex_set_clear(new_frontier);
+        probe_begin_level(&probe);
+
+        if (frontier->count < top_down_threshold * graph->num_nodes) {
+            top_down_step3_compressed(graph, frontier, new_frontier, sol->distances, nextLevel, ws->local_buffers);
+            probe_end_level(&probe, "top_down", frontier->count,
+                            [&] { return top_down_edges_compressed(graph, frontier); });
+        }
+        else {
+            bottomUpParallel_compressed(graph, new_frontier, sol->distances, currentLevel, nextLevel, ws->local_buffers);
+            probe_end_level(&probe, "bottom_up", frontier->count,
+                            [&] { return bottom_up_edges_compressed(graph, sol->distances, currentLevel, nextLevel); });
+        }
+
+        vertex_set* temp = frontier;
+        frontier = new_frontier;
+        new_frontier = temp;
+        currentLevel++;
+        nextLevel++;
+    }
+
+    probe_end_search(&probe);
+
+    if (ws == &temp_ws)
+        bfs_workspace_free(&temp_ws);
+}
+
+void bfs_top_down_compressed(CompressedGraph graph, solution* sol, Vertex root, bfs_workspace* ws)
+{
+    // a frontier never exceeds num_nodes, so every level is top-down
+    bfs_compressed(graph, sol, root, ws, 1.01, "top_down_compressed");
+}
+
+void bfs_bottom_up_compressed(CompressedGraph graph, solution* sol, Vertex root, bfs_workspace* ws)
+{
+    bfs_compressed(graph, sol, root, ws, 0.0, "bottom_up_compressed");
+}
+
+void bfs_hybrid_compressed(CompressedGraph graph, solution* sol, Vertex root, bfs_workspace* ws)
+{
+    bfs_compressed(graph, sol, root, ws, 0.05, "hybrid_compressed");
+}
+
+
+#define MS_BFS_WIDTH 64
+
+// One batch of up to 64 searches.  Bit i of seen[v] / frontier[v] says
+// whether search i has reached v / reached v on the last level.  Each
+// level pulls frontier bits over incoming edges, so no atomics are
+// needed and an edge is read once for all searches in the batch.
+static void ms_bfs_batch(Graph g, const Vertex* roots, int k, int* distances_out,
+                         uint64_t* seen, uint64_t* frontier, uint64_t* next)
+{
+    const int n = g->num_nodes;
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++) {
+        seen[v] = frontier[v] = 0;
+    }
+
+    #pragma omp parallel for
+    for (long i = 0; i < (long)k * n; i++)
+        distances_out[i] = NOT_VISITED_MARKER;
+
+    for (int i = 0; i < k; i++) {
+        seen[roots[i]] |= (uint64_t)1 << i;
+        frontier[roots[i]] |= (uint64_t)1 << i;
+        distances_out[(long)i * n + roots[i]] = 0;
+    }
+
+    // lanes of the k searches in this batch; the others never see anything
+    const uint64_t lanes = k == 64 ? ~0ULL : ((uint64_t)1 << k) - 1;
+
+    int level = 1;
+    int new_vertices = k;
+    while (new_vertices != 0) {
+
+        #pragma omp parallel for schedule(dynamic, 512)
+        for (int v = 0; v < n; v++) {
+            const uint64_t unseen = ~seen[v] & lanes;
+            uint64_t reached = 0;
+            if (unseen != 0) {
+                for (const Vertex* u = incoming_begin(g, v), *end = incoming_end(g, v); u < end; ++u) {
+                    reached |= frontier[*u];
+                    // stop once every search that could still reach v has
+                    if ((reached & unseen) == unseen) break;
+                }
+            }
+            next[v] = reached & unseen;
+        }
+
+        new_vertices = 0;
+        #pragma omp parallel for schedule(dynamic, 512) reduction(+:new_vertices)
+        for (int v = 0; v < n; v++) {
+            uint64_t bits = next[v];
+            if (bits == 0) continue;
+            seen[v] |= bits;
+            new_vertices++;
+            while (bits) {
+                int i = __builtin_ctzll(bits);
+                distances_out[(long)i * n + v] = level;
+                bits &= bits - 1;
+            }
+        }
+
+        uint64_t* temp = frontier;
+        frontier = next;
+        next = temp;
+        level++;
+    }
+}
+
+void bfs_multi_source(Graph graph, const Vertex* roots, int k, int* distances_out)
+{
+    const int n = graph->num_nodes;
+    std::unique_ptr<uint64_t[]> seen(new uint64_t[n]);
+    std::unique_ptr<uint64_t[]> frontier(new uint64_t[n]);
+    std::unique_ptr<uint64_t[]> next(new uint64_t[n]);
+
+    for (int first = 0; first < k; first += MS_BFS_WIDTH) {
+        int batch = std::min(MS_BFS_WIDTH, k - first);
+        ms_bfs_batch(graph, roots + first, batch, distances_out + (long)first * n,
+                     seen.get(), frontier.get(), next.get());
+    }
 }
@@ -3,7 +3,12 @@
 
 //#define DEBUG
 
+#include <stdio.h>
+
 #include "common/graph.h"
+#include "common/compressed_graph.h"
+
+#define ROOT_NODE_ID 0
 
 struct solution
 {
@@ -19,9 +24,92 @@ struct vertex_set {
   int *vertices;
 };
 
+// Per-level instrumentation: a search through a workspace with a
+// profile appends one CSV row per level to out, with the frontier size,
+// the edges examined, the direction chosen, the time and the hardware
+// counters of the level (see common/perf_counters.h).
+struct bfs_profile {
+  FILE *out;
+  bool header_written;
+};
+
+// Vertices a thread collects before spilling them into the shared
+// new frontier in one chunk.
+#define BFS_LOCAL_BUFFER_SIZE 4096
+
+// Scratch space for the searches, allocated once per graph and reused
+// by every search and every level: the two frontiers plus a bounded
+// buffer per thread.
+struct bfs_workspace {
+  vertex_set frontier;
+  vertex_set new_frontier;
+  // number of threads local_buffers has room for
+  int num_threads;
+  // num_threads buffers of BFS_LOCAL_BUFFER_SIZE vertices
+  Vertex *local_buffers;
+  // NULL unless the searches should be profiled
+  bfs_profile *profile;
+};
+
+void bfs_workspace_init(bfs_workspace* ws, int num_nodes);
+void bfs_workspace_free(bfs_workspace* ws);
+
+
+// Searches without a workspace allocate a temporary one.
+void bfs_top_down(Graph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+void bfs_bottom_up(Graph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+void bfs_hybrid(Graph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+
+// Fills parents[v] with a BFS-tree parent of every vertex reached in
+// distances (the root is its own parent, unreached vertices get -1).
+void bfs_parents(Graph graph, const int* distances, int* parents);
+
+// Same searches over varint-compressed adjacency lists, decoded while
+// iterating.
+void bfs_top_down_compressed(CompressedGraph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+void bfs_bottom_up_compressed(CompressedGraph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+void bfs_hybrid_compressed(CompressedGraph graph, solution* sol, Vertex root = ROOT_NODE_ID, bfs_workspace* ws = NULL);
+
+// Bit-parallel BFS from k roots at once: 64 searches share every edge
+// scan.  distances_out holds k rows of num_nodes distances; row i is
+// the search from roots[i].
+void bfs_multi_source(Graph graph, const Vertex* roots, int k, int* distances_out);
+
+
+// Semi-external graph: only the vertex offsets are read into memory,
+// the outgoing edges stay in the binary graph file.
+struct external_graph {
+  int num_nodes;
+  int num_edges;
+  // num_nodes + 1 entries; the last one is num_edges
+  int *outgoing_starts;
+  int fd;
+  // file offset of the first outgoing edge
+  size_t edges_offset;
+};
+
+using ExternalGraph = external_graph*;
+
+ExternalGraph open_graph_external(const char* filename);
+void close_graph_external(ExternalGraph graph);
+
+// Edges are fetched in blocks of this many bytes, and this many blocks
+// may be read ahead of the one being searched.
+#define BFS_EXTERNAL_BLOCK_BYTES (16 << 20)
+#define BFS_EXTERNAL_READ_AHEAD 4
+
+struct external_bfs_stats {
+  int levels;
+  long blocks_read;
+  long bytes_read;
+};
 
-void bfs_top_down(Graph graph, solution* sol);
-void bfs_bottom_up(Graph graph, solution* sol);
-void bfs_hybrid(Graph graph, solution* sol);
+// Top-down search with the distances and frontier bitmaps in memory.
+// Every level streams, in file order, only the edge blocks that hold
+// edges of frontier vertices; a background thread reads them with
+// pread while the OpenMP threads search the previous block.
+void bfs_top_down_external(ExternalGraph graph, solution* sol, Vertex root = ROOT_NODE_ID,
+                           size_t block_bytes = BFS_EXTERNAL_BLOCK_BYTES,
+                           external_bfs_stats* stats = NULL);
 
 #endif
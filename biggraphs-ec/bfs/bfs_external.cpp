@@ -0,0 +1,268 @@
+#include "bfs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../common/graph.h"
+
+#define NOT_VISITED_MARKER -1
+// same layout as store_graph_binary: token, num_nodes, num_edges
+#define GRAPH_HEADER_TOKEN ((int) 0xDEADBEEF)
+#define GRAPH_HEADER_INTS 3
+
+
+static void pread_or_die(int fd, void* buffer, size_t bytes, size_t offset, const char* what)
+{
+    char* p = (char*)buffer;
+    while (bytes > 0) {
+        ssize_t n = pread(fd, p, bytes, offset);
+        if (n <= 0) {
+            fprintf(stderr, "Error reading %s.\n", what);
+            exit(1);
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+}
+
+ExternalGraph open_graph_external(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    int header[GRAPH_HEADER_INTS];
+    pread_or_die(fd, header, sizeof(header), 0, "header");
+    if (header[0] != GRAPH_HEADER_TOKEN) {
+        fprintf(stderr, "Invalid graph file header. File may be corrupt.\n");
+        exit(1);
+    }
+
+    external_graph* graph = (struct external_graph*)(malloc(sizeof(struct external_graph)));
+    graph->num_nodes = header[1];
+    graph->num_edges = header[2];
+    graph->fd = fd;
+    graph->edges_offset = sizeof(header) + sizeof(int) * (size_t)graph->num_nodes;
+
+    graph->outgoing_starts = (int*)malloc(sizeof(int) * ((size_t)graph->num_nodes + 1));
+    pread_or_die(fd, graph->outgoing_starts, sizeof(int) * (size_t)graph->num_nodes, sizeof(header), "nodes");
+    graph->outgoing_starts[graph->num_nodes] = graph->num_edges;
+
+    // blocks of a level are fetched in increasing file order
+    posix_fadvise(fd, graph->edges_offset, 0, POSIX_FADV_SEQUENTIAL);
+
+    return graph;
+}
+
+void close_graph_external(ExternalGraph graph)
+{
+    close(graph->fd);
+    free(graph->outgoing_starts);
+    free(graph);
+}
+
+// Reads the blocks of one level on a background thread into a ring of
+// BFS_EXTERNAL_READ_AHEAD buffers.  acquire(i) waits for the i-th
+// block of the list, release() hands its buffer back to the reader.
+class block_reader {
+public:
+    block_reader(ExternalGraph graph, size_t block_edges, Vertex** buffers, const std::vector<int>& blocks)
+        : graph(graph), block_edges(block_edges), buffers(buffers), blocks(blocks),
+          produced(0), consumed(0), bytes_read(0) {
+        thread = std::thread(&block_reader::run, this);
+    }
+
+    ~block_reader() {
+        thread.join();
+    }
+
+    const Vertex* acquire(size_t i) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [&] { return produced > i; });
+        return buffers[i % BFS_EXTERNAL_READ_AHEAD];
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            consumed++;
+        }
+        ready.notify_all();
+    }
+
+    long bytes() const {
+        return bytes_read;
+    }
+
+private:
+    void run() {
+        for (size_t i = 0; i < blocks.size(); i++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return produced - consumed < BFS_EXTERNAL_READ_AHEAD; });
+            }
+
+            size_t first_edge = (size_t)blocks[i] * block_edges;
+            size_t count = std::min(block_edges, (size_t)graph->num_edges - first_edge);
+            pread_or_die(graph->fd, buffers[i % BFS_EXTERNAL_READ_AHEAD], sizeof(Vertex) * count,
+                         graph->edges_offset + sizeof(Vertex) * first_edge, "edges");
+            bytes_read += sizeof(Vertex) * count;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                produced++;
+            }
+            ready.notify_all();
+        }
+    }
+
+    ExternalGraph graph;
+    size_t block_edges;
+    Vertex** buffers;
+    const std::vector<int>& blocks;
+    size_t produced;
+    size_t consumed;
+    long bytes_read;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::thread thread;
+};
+
+static inline bool bitmap_test(const uint64_t* bitmap, Vertex v)
+{
+    return (bitmap[v >> 6] >> (v & 63)) & 1;
+}
+
+// Follows the edges of frontier vertices that lie in the block
+// [first_edge, first_edge + count).  Lists that cross a block boundary
+// are handled piecewise by consecutive blocks.
+static int search_block(ExternalGraph g, const Vertex* block, size_t first_edge, size_t count,
+                        const uint64_t* frontier, uint64_t* next_frontier, int* distances, int level)
+{
+    const int* starts = g->outgoing_starts;
+    int n = g->num_nodes;
+    size_t end_edge = first_edge + count;
+
+    // the vertices whose edge ranges overlap the block
+    Vertex first = (std::upper_bound(starts, starts + n, (int)first_edge) - starts) - 1;
+    Vertex last = std::lower_bound(starts, starts + n, (int)end_edge) - starts;
+
+    int discovered = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1024) reduction(+:discovered)
+    for (Vertex v = std::max(first, 0); v < last; v++) {
+        if (!bitmap_test(frontier, v))
+            continue;
+        size_t lo = std::max((size_t)starts[v], first_edge);
+        size_t hi = std::min((size_t)starts[v + 1], end_edge);
+        for (size_t e = lo; e < hi; e++) {
+            Vertex u = block[e - first_edge];
+            if (distances[u] == NOT_VISITED_MARKER &&
+                __sync_bool_compare_and_swap(&distances[u], NOT_VISITED_MARKER, level + 1)) {
+                __sync_fetch_and_or(&next_frontier[u >> 6], (uint64_t)1 << (u & 63));
+                discovered++;
+            }
+        }
+    }
+    return discovered;
+}
+
+void bfs_top_down_external(ExternalGraph graph, solution* sol, Vertex root, size_t block_bytes,
+                           external_bfs_stats* stats)
+{
+    int n = graph->num_nodes;
+    size_t block_edges = std::max(block_bytes / sizeof(Vertex), (size_t)1);
+    int num_blocks = (int)(((size_t)graph->num_edges + block_edges - 1) / block_edges);
+    size_t words = ((size_t)n + 63) / 64;
+
+    uint64_t* frontier = (uint64_t*)calloc(words, sizeof(uint64_t));
+    uint64_t* next_frontier = (uint64_t*)calloc(words, sizeof(uint64_t));
+    char* needed = (char*)malloc(num_blocks > 0 ? num_blocks : 1);
+    Vertex* buffers[BFS_EXTERNAL_READ_AHEAD];
+    for (int i = 0; i < BFS_EXTERNAL_READ_AHEAD; i++)
+        buffers[i] = (Vertex*)malloc(sizeof(Vertex) * block_edges);
+
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++)
+        sol->distances[i] = NOT_VISITED_MARKER;
+
+    sol->distances[root] = 0;
+    frontier[root >> 6] |= (uint64_t)1 << (root & 63);
+
+    int level = 0;
+    long blocks_read = 0;
+    long bytes_read = 0;
+    int frontier_count = 1;
+    std::vector<int> blocks;
+
+    while (frontier_count != 0) {
+
+        // mark the blocks that hold an edge of a frontier vertex
+        memset(needed, 0, num_blocks);
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (size_t w = 0; w < words; w++) {
+            uint64_t bits = frontier[w];
+            while (bits) {
+                Vertex v = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                size_t begin = graph->outgoing_starts[v];
+                size_t end = graph->outgoing_starts[v + 1];
+                if (begin == end)
+                    continue;
+                for (size_t b = begin / block_edges; b <= (end - 1) / block_edges; b++)
+                    needed[b] = 1;
+            }
+        }
+
+        blocks.clear();
+        for (int b = 0; b < num_blocks; b++)
+            if (needed[b])
+                blocks.push_back(b);
+
+        int discovered = 0;
+        {
+            block_reader reader(graph, block_edges, buffers, blocks);
+            for (size_t i = 0; i < blocks.size(); i++) {
+                const Vertex* block = reader.acquire(i);
+                size_t first_edge = (size_t)blocks[i] * block_edges;
+                size_t count = std::min(block_edges, (size_t)graph->num_edges - first_edge);
+                discovered += search_block(graph, block, first_edge, count,
+                                           frontier, next_frontier, sol->distances, level);
+                reader.release();
+            }
+            bytes_read += reader.bytes();
+        }
+        blocks_read += blocks.size();
+
+        std::swap(frontier, next_frontier);
+        memset(next_frontier, 0, words * sizeof(uint64_t));
+        frontier_count = discovered;
+        level++;
+    }
+
+    if (stats) {
+        stats->levels = level;
+        stats->blocks_read = blocks_read;
+        stats->bytes_read = bytes_read;
+    }
+
+    for (int i = 0; i < BFS_EXTERNAL_READ_AHEAD; i++)
+        free(buffers[i]);
+    free(needed);
+    free(next_frontier);
+    free(frontier);
+}
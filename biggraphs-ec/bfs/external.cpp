@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "../common/CycleTimer.h"
+#include "../common/graph.h"
+#include "bfs.h"
+
+// Semi-external BFS: the edges are streamed from the binary graph file
+// instead of loaded, so graphs larger than memory can be searched.  To
+// try that on a smaller graph, cap the memory of the run, e.g.
+//   systemd-run --scope -p MemoryMax=1G ./bfs_external graph.bin
+
+#define DEFAULT_BLOCK_MB 16
+
+void usage(const char* binary_name) {
+    std::cout << "Usage: " << binary_name << " [options] graphfile [num_threads]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -b  INT edge block size in MB (default " << DEFAULT_BLOCK_MB << ")" << std::endl;
+    std::cout << "  -r  INT root vertex (default " << ROOT_NODE_ID << ")" << std::endl;
+    std::cout << "  -m      also load the graph in memory and compare with bfs_top_down and bfs_hybrid" << std::endl;
+    std::cout << "  -h      this commandline help message" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t block_mb = DEFAULT_BLOCK_MB;
+    Vertex root = ROOT_NODE_ID;
+    bool in_memory = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:r:mh")) != EOF) {
+        switch (opt) {
+            case 'b':
+                block_mb = std::max(atoi(optarg), 1);
+                break;
+            case 'r':
+                root = atoi(optarg);
+                break;
+            case 'm':
+                in_memory = true;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (argc <= optind) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc > optind + 1)
+        thread_count = atoi(argv[optind + 1]);
+
+    std::string graph_filename = argv[optind];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("----------------------------------------------------------\n");
+
+    printf("Opening graph...\n");
+    ExternalGraph eg = open_graph_external(graph_filename.c_str());
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d (%.2f MB on disk)\n", eg->num_edges, sizeof(Vertex) * (double)eg->num_edges / (1024.0 * 1024.0));
+    printf("  Nodes: %d\n", eg->num_nodes);
+    printf("  Block: %zu MB, %d read ahead\n", block_mb, BFS_EXTERNAL_READ_AHEAD);
+
+    if (root < 0 || root >= eg->num_nodes) {
+        fprintf(stderr, "Root %d is not a vertex of the graph.\n", root);
+        exit(1);
+    }
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    solution external_sol;
+    external_sol.distances = (int*)malloc(sizeof(int) * eg->num_nodes);
+
+    std::vector<double> external_times;
+    std::stringstream timing;
+    timing << "Threads  External          Levels  Blocks  MB Read\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++) {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        external_bfs_stats stats;
+        double start = CycleTimer::currentSeconds();
+        bfs_top_down_external(eg, &external_sol, root, block_mb << 20, &stats);
+        double time = CycleTimer::currentSeconds() - start;
+        external_times.push_back(time);
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3f (%.2fx)     %4d  %6ld  %8.1f\n",
+                num_threads[i], time, external_times[0] / time,
+                stats.levels, stats.blocks_read, stats.bytes_read / (1024.0 * 1024.0));
+        timing << buf;
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "Semi-External BFS: Timing Summary" << std::endl;
+    std::cout << timing.str();
+
+    if (in_memory) {
+        Graph g = load_graph_binary(graph_filename.c_str());
+        solution sol;
+        sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        bfs_workspace ws;
+        bfs_workspace_init(&ws, g->num_nodes);
+
+        bool check = true;
+        std::stringstream memory_timing;
+        memory_timing << "Threads  External   Top Down   Hybrid\n";
+
+        for (size_t i = 0; i < num_threads.size(); i++) {
+            omp_set_num_threads(num_threads[i]);
+
+            double start = CycleTimer::currentSeconds();
+            bfs_top_down(g, &sol, root, &ws);
+            double top_time = CycleTimer::currentSeconds() - start;
+
+            start = CycleTimer::currentSeconds();
+            bfs_hybrid(g, &sol, root, &ws);
+            double hybrid_time = CycleTimer::currentSeconds() - start;
+
+            // the last external run used the same root
+            for (int j = 0; j < g->num_nodes; j++) {
+                if (sol.distances[j] != external_sol.distances[j]) {
+                    fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j, sol.distances[j], external_sol.distances[j]);
+                    check = false;
+                    break;
+                }
+            }
+
+            char buf[1024];
+            sprintf(buf, "%4d:    %7.3f    %7.3f    %7.3f\n",
+                    num_threads[i], external_times[i], top_time, hybrid_time);
+            memory_timing << buf;
+        }
+
+        printf("----------------------------------------------------------\n");
+        std::cout << "External vs. In-Memory: Timing Summary" << std::endl;
+        std::cout << memory_timing.str();
+        if (!check)
+            std::cout << "Semi-External Search is not Correct" << std::endl;
+
+        bfs_workspace_free(&ws);
+        free(sol.distances);
+        free_graph(g);
+    }
+    printf("----------------------------------------------------------\n");
+
+    free(external_sol.distances);
+    close_graph_external(eg);
+
+    return 0;
+}
@@ -73,6 +73,8 @@ void run_on_graph(int idx, graph* g, int num_threads, int num_runs,
     ref.distances = new int[g->num_nodes];
     solution stu;
     stu.distances = new int[g->num_nodes];
+    bfs_workspace ws;
+    bfs_workspace_init(&ws, g->num_nodes);
 
     double start, time;
 
@@ -90,7 +92,7 @@ void run_on_graph(int idx, graph* g, int num_threads, int num_runs,
     double stu_top_down_time = std::numeric_limits<int>::max();
     for (int r = 0; r < num_runs; r++) {
         start = CycleTimer::currentSeconds();
-        bfs_top_down(g, &stu);
+        bfs_top_down(g, &stu, ROOT_NODE_ID, &ws);
         //reference_bfs_top_down(g, &stu);
         time = CycleTimer::currentSeconds() - start;
         stu_top_down_time = std::min(stu_top_down_time, time);
@@ -125,7 +127,7 @@ void run_on_graph(int idx, graph* g, int num_threads, int num_runs,
     double stu_bottom_up_time = std::numeric_limits<int>::max();
     for (int r = 0; r < num_runs; r++) {
         start = CycleTimer::currentSeconds();
-        bfs_bottom_up(g, &stu);
+        bfs_bottom_up(g, &stu, ROOT_NODE_ID, &ws);
         //reference_bfs_bottom_up(g, &stu);
         time = CycleTimer::currentSeconds() - start;
         stu_bottom_up_time = std::min(stu_bottom_up_time, time);
@@ -162,7 +164,7 @@ void run_on_graph(int idx, graph* g, int num_threads, int num_runs,
     double stu_hybrid_time = std::numeric_limits<int>::max();
     for (int r = 0; r < num_runs; r++) {
         start = CycleTimer::currentSeconds();
-        bfs_hybrid(g, &stu);
+        bfs_hybrid(g, &stu, ROOT_NODE_ID, &ws);
         //reference_bfs_hybrid(g, &stu);
         time = CycleTimer::currentSeconds() - start;
         stu_hybrid_time = std::min(stu_hybrid_time, time);
@@ -180,6 +182,7 @@ void run_on_graph(int idx, graph* g, int num_threads, int num_runs,
 
     scores[idx][hybrid] = compute_score(graph_name, correct, ref_hybrid_time, stu_hybrid_time);
 
+    bfs_workspace_free(&ws);
     delete(stu.distances);
     delete(ref.distances);
 }
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <random>
 
 #include "common/CycleTimer.h"
 #include "common/graph.h"
@@ -18,26 +19,300 @@ void reference_bfs_bottom_up(Graph graph, solution* sol);
 void reference_bfs_top_down(Graph graph, solution* sol);
 void reference_bfs_hybrid(Graph graph, solution* sol);
 
+// The reference implementations always search from vertex 0.  On a
+// relabeled graph the original root has a different id, so check
+// against a serial search from that vertex instead.
+void reference_bfs(void (*ref_bfs)(Graph, solution*), Graph g, solution* sol, Vertex root) {
+
+    if (root == ROOT_NODE_ID) {
+        ref_bfs(g, sol);
+        return;
+    }
+
+    for (int i=0; i<g->num_nodes; i++)
+        sol->distances[i] = -1;
+
+    std::vector<Vertex> queue;
+    queue.push_back(root);
+    sol->distances[root] = 0;
+    for (size_t head=0; head<queue.size(); head++) {
+        Vertex u = queue[head];
+        for (const Vertex* v=outgoing_begin(g, u); v!=outgoing_end(g, u); v++) {
+            if (sol->distances[*v] == -1) {
+                sol->distances[*v] = sol->distances[u] + 1;
+                queue.push_back(*v);
+            }
+        }
+    }
+}
+
+// Times each search on the CSR graph and on its compressed form,
+// checking that both give the same distances.
+void compare_compressed(Graph g, Vertex root, const std::vector<int>& num_threads, bfs_workspace* ws) {
+
+    double start = CycleTimer::currentSeconds();
+    CompressedGraph cg = compress_graph(g);
+    double compress_time = CycleTimer::currentSeconds() - start;
+
+    size_t csr_bytes = graph_bytes(g);
+    size_t compressed_bytes = compressed_graph_bytes(cg);
+    printf("----------------------------------------------------------\n");
+    printf("CSR size:        %10.2f MB\n", csr_bytes / (1024.0 * 1024.0));
+    printf("Compressed size: %10.2f MB (%.2fx smaller, built in %.2f sec)\n",
+           compressed_bytes / (1024.0 * 1024.0), (double)csr_bytes / compressed_bytes, compress_time);
+
+    void (*csr_bfs[3])(Graph, solution*, Vertex, bfs_workspace*) = { bfs_top_down, bfs_bottom_up, bfs_hybrid };
+    void (*compressed_bfs[3])(CompressedGraph, solution*, Vertex, bfs_workspace*) =
+        { bfs_top_down_compressed, bfs_bottom_up_compressed, bfs_hybrid_compressed };
+
+    solution csr_sol;
+    csr_sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+    solution compressed_sol;
+    compressed_sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Top Down (CSR/comp)  Bottom Up (CSR/comp)  Hybrid (CSR/comp)\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++) {
+        omp_set_num_threads(num_threads[i]);
+
+        char buf[1024];
+        int len = sprintf(buf, "%4d:  ", num_threads[i]);
+        for (int v = 0; v < 3; v++) {
+            start = CycleTimer::currentSeconds();
+            csr_bfs[v](g, &csr_sol, root, ws);
+            double csr_time = CycleTimer::currentSeconds() - start;
+
+            start = CycleTimer::currentSeconds();
+            compressed_bfs[v](cg, &compressed_sol, root, ws);
+            double compressed_time = CycleTimer::currentSeconds() - start;
+
+            for (int j=0; j<g->num_nodes; j++) {
+                if (csr_sol.distances[j] != compressed_sol.distances[j]) {
+                    fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j, csr_sol.distances[j], compressed_sol.distances[j]);
+                    check = false;
+                    break;
+                }
+            }
+            len += sprintf(buf + len, "     %7.3f / %7.3f", csr_time, compressed_time);
+        }
+        timing << buf << "\n";
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "CSR vs. Compressed: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    if (!check)
+        std::cout << "Compressed Search is not Correct" << std::endl;
+
+    free(csr_sol.distances);
+    free(compressed_sol.distances);
+    free_compressed_graph(cg);
+}
+
+// Searches a file written by graphTools compress without ever building
+// the CSR, so graphs whose CSR does not fit in memory can be searched.
+// The three searches check each other, as there is no CSR to compare to.
+void search_compressed_file(const char* filename, const std::string& perm_filename,
+                            const std::vector<int>& num_threads) {
+
+    double start = CycleTimer::currentSeconds();
+    CompressedGraph cg = load_compressed_graph_binary(filename);
+    double load_time = CycleTimer::currentSeconds() - start;
+
+    size_t csr_bytes = graph_bytes(cg->num_nodes, cg->num_edges);
+    size_t compressed_bytes = compressed_graph_bytes(cg);
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d\n", cg->num_edges);
+    printf("  Nodes: %d\n", cg->num_nodes);
+
+    Vertex root = ROOT_NODE_ID;
+    if (!perm_filename.empty()) {
+        Vertex* new_id = load_permutation_binary(perm_filename.c_str(), cg->num_nodes);
+        root = new_id[ROOT_NODE_ID];
+        printf("  Root: vertex %d is %d in the relabeled graph\n", ROOT_NODE_ID, root);
+        free(new_id);
+    }
+    printf("----------------------------------------------------------\n");
+    printf("CSR size:        %10.2f MB (not built)\n", csr_bytes / (1024.0 * 1024.0));
+    printf("Compressed size: %10.2f MB (%.2fx smaller, loaded in %.2f sec)\n",
+           compressed_bytes / (1024.0 * 1024.0), (double)csr_bytes / compressed_bytes, load_time);
+
+    void (*compressed_bfs[3])(CompressedGraph, solution*, Vertex, bfs_workspace*) =
+        { bfs_top_down_compressed, bfs_bottom_up_compressed, bfs_hybrid_compressed };
+
+    bfs_workspace ws;
+    bfs_workspace_init(&ws, cg->num_nodes);
+    solution sols[3];
+    for (int v = 0; v < 3; v++)
+        sols[v].distances = (int*)malloc(sizeof(int) * cg->num_nodes);
+
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Top Down  Bottom Up  Hybrid\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++) {
+        omp_set_num_threads(num_threads[i]);
+
+        char buf[1024];
+        int len = sprintf(buf, "%4d:  ", num_threads[i]);
+        for (int v = 0; v < 3; v++) {
+            start = CycleTimer::currentSeconds();
+            compressed_bfs[v](cg, &sols[v], root, &ws);
+            len += sprintf(buf + len, "  %7.3f", CycleTimer::currentSeconds() - start);
+        }
+        for (int v = 1; v < 3; v++) {
+            for (int j=0; j<cg->num_nodes; j++) {
+                if (sols[0].distances[j] != sols[v].distances[j]) {
+                    fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j, sols[0].distances[j], sols[v].distances[j]);
+                    check = false;
+                    break;
+                }
+            }
+        }
+        timing << buf << "\n";
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "Compressed File: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    if (!check)
+        std::cout << "Compressed Searches Disagree" << std::endl;
+
+    for (int v = 0; v < 3; v++)
+        free(sols[v].distances);
+    bfs_workspace_free(&ws);
+    free_compressed_graph(cg);
+}
+
+// Times one multi-source search from k roots against k hybrid
+// searches, checking that every row of distances matches.
+void compare_multi_source(Graph g, int k, const std::vector<int>& num_threads, bfs_workspace* ws) {
+
+    // fixed seed so every run uses the same roots
+    std::vector<Vertex> roots;
+    std::mt19937 rng(149);
+    std::uniform_int_distribution<int> pick(0, g->num_nodes - 1);
+    for (int tries = 0; (int)roots.size() < k && tries < 100 * k; tries++) {
+        Vertex v = pick(rng);
+        if (outgoing_size(g, v) > 0)
+            roots.push_back(v);
+    }
+    k = roots.size();
+
+    int* multi = (int*)malloc(sizeof(int) * (size_t)k * g->num_nodes);
+    solution sol;
+    sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Multi-Source     " << k << " x Hybrid\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++) {
+        omp_set_num_threads(num_threads[i]);
+
+        double start = CycleTimer::currentSeconds();
+        bfs_multi_source(g, roots.data(), k, multi);
+        double multi_time = CycleTimer::currentSeconds() - start;
+
+        double hybrid_time = 0;
+        for (int r = 0; r < k; r++) {
+            start = CycleTimer::currentSeconds();
+            bfs_hybrid(g, &sol, roots[r], ws);
+            hybrid_time += CycleTimer::currentSeconds() - start;
+
+            const int* row = multi + (size_t)r * g->num_nodes;
+            for (int j=0; check && j<g->num_nodes; j++) {
+                if (sol.distances[j] != row[j]) {
+                    fprintf(stderr, "*** Results disagree for root %d at %d: %d, %d\n", roots[r], j, sol.distances[j], row[j]);
+                    check = false;
+                }
+            }
+        }
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %8.3f        %8.3f   (%.2fx)\n",
+                num_threads[i], multi_time, hybrid_time, hybrid_time / multi_time);
+        timing << buf;
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "Multi-Source: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    if (!check)
+        std::cout << "Multi-Source Search is not Correct" << std::endl;
+
+    free(multi);
+    free(sol.distances);
+}
+
+void usage(const char* binary_name) {
+    std::cerr << "Usage: " << binary_name << " [-c] [-z] [-m num_roots] [-p path/to/perm/file] [-a policy] [-l profile.csv] <path/to/graph/file> [num_threads]\n";
+    std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+    std::cerr << "  Run with a certain number of threads (no correctness run): <path/to/graph/file> <num_threads>\n";
+    std::cerr << "  Graph relabeled by graphTools: -p <path/to/perm/file> <path/to/graph/file>\n";
+    std::cerr << "  Compare against compressed adjacency lists: -c <path/to/graph/file>\n";
+    std::cerr << "  Search a file from graphTools compress without building the CSR: -z <path/to/compressed/file>\n";
+    std::cerr << "  Compare multi-source BFS against repeated hybrid BFS: -m <num_roots> <path/to/graph/file>\n";
+    std::cerr << "  Place the graph and distance arrays with malloc (default), firsttouch, interleave or hugepages: -a <policy>\n";
+    std::cerr << "  Append per-level frontier, edge and hardware counter statistics of every search as CSV: -l <profile.csv>\n";
+}
+
 int main(int argc, char** argv) {
 
     int  num_threads = -1;
     std::string graph_filename;
+    std::string perm_filename;
+    bool compressed = false;
+    bool compressed_file = false;
+    int multi_source_roots = 0;
+    alloc_policy policy = ALLOC_MALLOC;
+    std::string profile_filename;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:cl:m:p:zh")) != EOF) {
+        switch (opt) {
+            case 'a':
+                policy = parse_alloc_policy(optarg);
+                break;
+            case 'l':
+                profile_filename = optarg;
+                break;
+            case 'm':
+                multi_source_roots = atoi(optarg);
+                break;
+            case 'c':
+                compressed = true;
+                break;
+            case 'p':
+                perm_filename = optarg;
+                break;
+            case 'z':
+                compressed_file = true;
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
 
-    if (argc < 2)
+    if (argc <= optind)
     {
-        std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
-        std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
-        std::cerr << "  Run with a certain number of threads (no correctness run): <path/to/graph/file> <num_threads>\n";
+        usage(argv[0]);
         exit(1);
     }
 
     int thread_count = -1;
-    if (argc == 3)
+    if (argc == optind + 2)
     {
-        thread_count = atoi(argv[2]);
+        thread_count = atoi(argv[optind + 1]);
     }
 
-    graph_filename = argv[1];
+    graph_filename = argv[optind];
 
     Graph g;
 
@@ -50,11 +325,25 @@ int main(int argc, char** argv) {
     }
     printf("----------------------------------------------------------\n");
 
+    if (compressed_file) {
+        std::vector<int> num_threads;
+        if (thread_count > 0) {
+            num_threads.push_back(thread_count);
+        } else {
+            for (int i = 1; i < omp_get_max_threads(); i *= 2)
+                num_threads.push_back(i);
+            num_threads.push_back(omp_get_max_threads());
+        }
+        printf("Loading compressed graph...\n");
+        search_compressed_file(graph_filename.c_str(), perm_filename, num_threads);
+        return 0;
+    }
+
     printf("Loading graph...\n");
     if (USE_BINARY_GRAPH) {
-      g = load_graph_binary(graph_filename.c_str());
+      g = load_graph_binary(graph_filename.c_str(), policy);
     } else {
-        g = load_graph(argv[1]);
+        g = load_graph(graph_filename.c_str());
         printf("storing binary form of graph!\n");
         store_graph_binary(graph_filename.append(".bin").c_str(), g);
         delete g;
@@ -64,6 +353,56 @@ int main(int argc, char** argv) {
     printf("Graph stats:\n");
     printf("  Edges: %d\n", g->num_edges);
     printf("  Nodes: %d\n", g->num_nodes);
+    printf("  Allocation: %s\n", alloc_policy_name(policy));
+
+    // allocated once and reused by every search below
+    bfs_workspace ws;
+    bfs_workspace_init(&ws, g->num_nodes);
+
+    bfs_profile profile;
+    if (!profile_filename.empty()) {
+        profile.out = fopen(profile_filename.c_str(), "w");
+        if (!profile.out) {
+            fprintf(stderr, "Could not open %s for writing\n", profile_filename.c_str());
+            exit(1);
+        }
+        profile.header_written = false;
+        ws.profile = &profile;
+    }
+
+    // ROOT_NODE_ID names a vertex of the original graph
+    Vertex root = ROOT_NODE_ID;
+    Vertex* new_id = NULL;
+    if (!perm_filename.empty()) {
+        new_id = load_permutation_binary(perm_filename.c_str(), g->num_nodes);
+        root = new_id[ROOT_NODE_ID];
+        printf("  Root: vertex %d is %d in the relabeled graph\n", ROOT_NODE_ID, root);
+    }
+
+    // Off vertex 0 the reference is a serial search, so only its
+    // distances are used; its timings are not reported.
+    bool has_reference = (root == ROOT_NODE_ID);
+
+    if (compressed || multi_source_roots > 0) {
+        std::vector<int> num_threads;
+        if (thread_count > 0) {
+            num_threads.push_back(thread_count);
+        } else {
+            for (int i = 1; i < omp_get_max_threads(); i *= 2)
+                num_threads.push_back(i);
+            num_threads.push_back(omp_get_max_threads());
+        }
+        if (compressed)
+            compare_compressed(g, root, num_threads, &ws);
+        if (multi_source_roots > 0)
+            compare_multi_source(g, multi_source_roots, num_threads, &ws);
+        if (ws.profile)
+            fclose(profile.out);
+        bfs_workspace_free(&ws);
+        free(new_id);
+        delete g;
+        return 0;
+    }
 
     //If we want to run on all threads
     if (thread_count <= -1)
@@ -82,15 +421,15 @@ int main(int argc, char** argv) {
         int n_usage = num_threads.size();
 
         solution sol1;
-        sol1.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol1.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
         solution sol2;
-        sol2.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol2.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
         solution sol3;
-        sol3.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol3.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
 
         //Solution sphere
         solution sol4;
-        sol4.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol4.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
 
         double hybrid_base, top_base, bottom_base;
         double hybrid_time, top_time, bottom_time;
@@ -119,12 +458,12 @@ int main(int argc, char** argv) {
 
             //Run implementations
             start = CycleTimer::currentSeconds();
-            bfs_top_down(g, &sol1);
+            bfs_top_down(g, &sol1, root, &ws);
             top_time = CycleTimer::currentSeconds() - start;
 
             //Run reference implementation
             start = CycleTimer::currentSeconds();
-            reference_bfs_top_down(g, &sol4);
+            reference_bfs(reference_bfs_top_down, g, &sol4, root);
             ref_top_time = CycleTimer::currentSeconds() - start;
 
             std::cout << "Testing Correctness of Top Down\n";
@@ -139,12 +478,12 @@ int main(int argc, char** argv) {
 
             //Run implementations
             start = CycleTimer::currentSeconds();
-            bfs_bottom_up(g, &sol2);
+            bfs_bottom_up(g, &sol2, root, &ws);
             bottom_time = CycleTimer::currentSeconds() - start;
 
             //Run reference implementation
             start = CycleTimer::currentSeconds();
-            reference_bfs_bottom_up(g, &sol4);
+            reference_bfs(reference_bfs_bottom_up, g, &sol4, root);
             ref_bottom_time = CycleTimer::currentSeconds() - start;
 
             std::cout << "Testing Correctness of Bottom Up\n";
@@ -157,12 +496,12 @@ int main(int argc, char** argv) {
             }
 
             start = CycleTimer::currentSeconds();
-            bfs_hybrid(g, &sol3);
+            bfs_hybrid(g, &sol3, root, &ws);
             hybrid_time = CycleTimer::currentSeconds() - start;
 
             //Run reference implementation
             start = CycleTimer::currentSeconds();
-            reference_bfs_hybrid(g, &sol4);
+            reference_bfs(reference_bfs_hybrid, g, &sol4, root);
             ref_hybrid_time = CycleTimer::currentSeconds() - start;
 
             std::cout << "Testing Correctness of Hybrid\n";
@@ -207,9 +546,11 @@ int main(int argc, char** argv) {
         std::cout << "Your Code: Timing Summary" << std::endl;
         std::cout << timing.str();
         printf("----------------------------------------------------------\n");
-        std::cout << "Reference: Timing Summary" << std::endl;
-        std::cout << ref_timing.str();
-        printf("----------------------------------------------------------\n");
+        if (has_reference) {
+            std::cout << "Reference: Timing Summary" << std::endl;
+            std::cout << ref_timing.str();
+            printf("----------------------------------------------------------\n");
+        }
         std::cout << "Correctness: " << std::endl;
         if (!tds_check)
             std::cout << "Top Down Search is not Correct" << std::endl;
@@ -217,22 +558,25 @@ int main(int argc, char** argv) {
             std::cout << "Bottom Up Search is not Correct" << std::endl;
         if (!hs_check)
             std::cout << "Hybrid Search is not Correct" << std::endl;
-        std::cout << std::endl << "Speedup vs. Reference: " << std::endl <<  relative_timing.str();
+        if (has_reference)
+            std::cout << std::endl << "Speedup vs. Reference: " << std::endl <<  relative_timing.str();
+        else
+            std::cout << std::endl << "Speedup vs. Reference: not available (relabeled root, checked against serial BFS)" << std::endl;
     }
     //Run the code with only one thread count and only report speedup
     else
     {
         bool tds_check = true, bus_check = true, hs_check = true;
         solution sol1;
-        sol1.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol1.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
         solution sol2;
-        sol2.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol2.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
         solution sol3;
-        sol3.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol3.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
 
         //Solution sphere
         solution sol4;
-        sol4.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+        sol4.distances = (int*)graph_alloc(sizeof(int) * g->num_nodes, policy);
 
         double hybrid_time, top_time, bottom_time;
         double ref_hybrid_time, ref_top_time, ref_bottom_time;
@@ -252,12 +596,12 @@ int main(int argc, char** argv) {
 
         //Run implementations
         start = CycleTimer::currentSeconds();
-        bfs_top_down(g, &sol1);
+        bfs_top_down(g, &sol1, root, &ws);
         top_time = CycleTimer::currentSeconds() - start;
 
         //Run reference implementation
         start = CycleTimer::currentSeconds();
-        reference_bfs_top_down(g, &sol4);
+        reference_bfs(reference_bfs_top_down, g, &sol4, root);
         ref_top_time = CycleTimer::currentSeconds() - start;
 
         std::cout << "Testing Correctness of Top Down\n";
@@ -272,12 +616,12 @@ int main(int argc, char** argv) {
 
         //Run implementations
         start = CycleTimer::currentSeconds();
-        bfs_bottom_up(g, &sol2);
+        bfs_bottom_up(g, &sol2, root, &ws);
         bottom_time = CycleTimer::currentSeconds() - start;
 
         //Run reference implementation
         start = CycleTimer::currentSeconds();
-        reference_bfs_bottom_up(g, &sol4);
+        reference_bfs(reference_bfs_bottom_up, g, &sol4, root);
         ref_bottom_time = CycleTimer::currentSeconds() - start;
 
         std::cout << "Testing Correctness of Bottom Up\n";
@@ -291,12 +635,12 @@ int main(int argc, char** argv) {
 
 
         start = CycleTimer::currentSeconds();
-        bfs_hybrid(g, &sol3);
+        bfs_hybrid(g, &sol3, root, &ws);
         hybrid_time = CycleTimer::currentSeconds() - start;
 
         //Run reference implementation
         start = CycleTimer::currentSeconds();
-        reference_bfs_hybrid(g, &sol4);
+        reference_bfs(reference_bfs_hybrid, g, &sol4, root);
         ref_hybrid_time = CycleTimer::currentSeconds() - start;
 
         std::cout << "Testing Correctness of Hybrid\n";
@@ -329,11 +673,17 @@ int main(int argc, char** argv) {
         std::cout << "Your Code: Timing Summary" << std::endl;
         std::cout << timing.str();
         printf("----------------------------------------------------------\n");
-        std::cout << "Reference: Timing Summary" << std::endl;
-        std::cout << ref_timing.str();
-        printf("----------------------------------------------------------\n");
+        if (has_reference) {
+            std::cout << "Reference: Timing Summary" << std::endl;
+            std::cout << ref_timing.str();
+            printf("----------------------------------------------------------\n");
+        }
     }
 
+    if (ws.profile)
+        fclose(profile.out);
+    bfs_workspace_free(&ws);
+    free(new_id);
     delete g;
 
     return 0;
@@ -0,0 +1,131 @@
+#include "cc.h"
+
+#include <stdlib.h>
+#include <omp.h>
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+
+#include "../common/graph.h"
+
+
+// Joins the trees of u and v.  The higher root is hooked under the
+// lower one with a compare-and-swap; if another thread moved it first,
+// retry from the new roots.
+static inline void link(Vertex u, Vertex v, Vertex* comp)
+{
+    Vertex p1 = comp[u];
+    Vertex p2 = comp[v];
+    while (p1 != p2) {
+        Vertex high = p1 > p2 ? p1 : p2;
+        Vertex low = p1 + (p2 - high);
+        Vertex p_high = comp[high];
+        if (p_high == low)
+            break;
+        if (p_high == high && __sync_bool_compare_and_swap(&comp[high], high, low))
+            break;
+        p1 = comp[comp[high]];
+        p2 = comp[low];
+    }
+}
+
+// Points every vertex straight at its root.
+static void compress(Graph g, Vertex* comp)
+{
+    #pragma omp parallel for schedule(dynamic, 16384)
+    for (int v = 0; v < g->num_nodes; v++) {
+        while (comp[v] != comp[comp[v]])
+            comp[v] = comp[comp[v]];
+    }
+}
+
+// The most common root among a few random vertices: after sampling,
+// almost always the giant component.
+static Vertex sample_frequent_element(Graph g, const Vertex* comp)
+{
+    std::unordered_map<Vertex, int> counts;
+    std::mt19937 rng(149);
+    std::uniform_int_distribution<int> pick(0, g->num_nodes - 1);
+    for (int i = 0; i < AFFOREST_NUM_SAMPLES; i++)
+        counts[comp[pick(rng)]]++;
+
+    Vertex most_frequent = comp[0];
+    int best = 0;
+    for (auto& entry : counts) {
+        if (entry.second > best) {
+            best = entry.second;
+            most_frequent = entry.first;
+        }
+    }
+    return most_frequent;
+}
+
+void cc_afforest(Graph g, Vertex* comp, int neighbor_rounds)
+{
+    int n = num_nodes(g);
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++)
+        comp[v] = v;
+
+    if (n == 0)
+        return;
+
+    // link the first few outgoing neighbors of every vertex
+    for (int r = 0; r < neighbor_rounds; r++) {
+        #pragma omp parallel for schedule(dynamic, 16384)
+        for (int u = 0; u < n; u++) {
+            if (r < outgoing_size(g, u))
+                link(u, outgoing_begin(g, u)[r], comp);
+        }
+        compress(g, comp);
+    }
+
+    Vertex c = sample_frequent_element(g, comp);
+
+    // Vertices already in c need no more work: any edge from one of
+    // them to another component is seen from the other end, as an
+    // incoming edge there.
+    #pragma omp parallel for schedule(dynamic, 16384)
+    for (int u = 0; u < n; u++) {
+        if (comp[u] == c)
+            continue;
+        for (const Vertex* v = outgoing_begin(g, u) + neighbor_rounds; v < outgoing_end(g, u); v++)
+            link(u, *v, comp);
+        for (const Vertex* v = incoming_begin(g, u); v < incoming_end(g, u); v++)
+            link(u, *v, comp);
+    }
+
+    compress(g, comp);
+}
+
+int cc_label_propagation(Graph g, Vertex* comp)
+{
+    int n = num_nodes(g);
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++)
+        comp[v] = v;
+
+    // Labels only ever decrease, so updating them in place while other
+    // threads read them still converges to the component minimum.
+    int sweeps = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        #pragma omp parallel for schedule(dynamic, 16384) reduction(||:changed)
+        for (int v = 0; v < n; v++) {
+            Vertex label = comp[v];
+            for (const Vertex* u = outgoing_begin(g, v); u < outgoing_end(g, v); u++)
+                label = std::min(label, comp[*u]);
+            for (const Vertex* u = incoming_begin(g, v); u < incoming_end(g, v); u++)
+                label = std::min(label, comp[*u]);
+            if (label < comp[v]) {
+                comp[v] = label;
+                changed = true;
+            }
+        }
+        sweeps++;
+    }
+    return sweeps;
+}
@@ -0,0 +1,25 @@
+#ifndef __CC_H__
+#define __CC_H__
+
+#include "common/graph.h"
+
+// Number of neighbors per vertex linked before the largest component
+// is guessed, as in the Afforest paper.
+#define AFFOREST_NEIGHBOR_ROUNDS 2
+// Vertices sampled to guess the largest component.
+#define AFFOREST_NUM_SAMPLES 1024
+
+// Weakly connected components: edges are followed in both directions.
+// On return comp[v] is the smallest vertex id in v's component, for
+// both implementations.
+
+// Afforest: lock-free union-find over a few sampled neighbors per
+// vertex, then a full link pass that skips the (likely) largest
+// component found by sampling, then parallel path compression.
+void cc_afforest(Graph g, Vertex* comp, int neighbor_rounds = AFFOREST_NEIGHBOR_ROUNDS);
+
+// Baseline: every vertex repeatedly takes the minimum label of its
+// neighbors until no label changes.  Returns the number of sweeps.
+int cc_label_propagation(Graph g, Vertex* comp);
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "cc.h"
+
+int main(int argc, char** argv) {
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
+        std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+        std::cerr << "  Run with a certain number of threads: <path/to/graph/file> <num_threads>\n";
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc == 3)
+    {
+        thread_count = atoi(argv[2]);
+    }
+
+    std::string graph_filename = argv[1];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("----------------------------------------------------------\n");
+
+    printf("Loading graph...\n");
+    Graph g = load_graph_binary(graph_filename.c_str());
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d\n", g->num_edges);
+    printf("  Nodes: %d\n", g->num_nodes);
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    Vertex* afforest_comp = (Vertex*)malloc(sizeof(Vertex) * g->num_nodes);
+    Vertex* lp_comp = (Vertex*)malloc(sizeof(Vertex) * g->num_nodes);
+
+    double afforest_base = 0, lp_base = 0;
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Afforest          Label Prop        LP Sweeps\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++)
+    {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        double start = CycleTimer::currentSeconds();
+        cc_afforest(g, afforest_comp);
+        double afforest_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        int sweeps = cc_label_propagation(g, lp_comp);
+        double lp_time = CycleTimer::currentSeconds() - start;
+
+        // both label a component with its smallest vertex id
+        std::cout << "Testing Correctness of Afforest\n";
+        for (int j = 0; j < g->num_nodes; j++) {
+            if (afforest_comp[j] != lp_comp[j]) {
+                fprintf(stderr, "*** Results disagree at %d: %d, %d\n", j, afforest_comp[j], lp_comp[j]);
+                check = false;
+                break;
+            }
+        }
+
+        if (i == 0)
+        {
+            afforest_base = afforest_time;
+            lp_base = lp_time;
+        }
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3f (%.2fx)     %.3f (%.2fx)     %d\n",
+                num_threads[i], afforest_time, afforest_base/afforest_time,
+                lp_time, lp_base/lp_time, sweeps);
+        timing << buf;
+    }
+
+    // component sizes, indexed by label
+    std::vector<int> sizes(g->num_nodes, 0);
+    for (int j = 0; j < g->num_nodes; j++)
+        sizes[afforest_comp[j]]++;
+    int num_components = 0, largest = 0;
+    for (int j = 0; j < g->num_nodes; j++) {
+        if (sizes[j] > 0) num_components++;
+        largest = std::max(largest, sizes[j]);
+    }
+
+    printf("----------------------------------------------------------\n");
+    printf("Components: %d (largest has %d vertices)\n", num_components, largest);
+    std::cout << "Connected Components: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    printf("----------------------------------------------------------\n");
+    if (!check)
+        std::cout << "Afforest does not match Label Propagation" << std::endl;
+
+    free(afforest_comp);
+    free(lp_comp);
+    free_graph(g);
+
+    return 0;
+}
@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+
+#include "compressed_graph.h"
+#include "graph_internal.h"
+
+#define COMPRESSED_GRAPH_HEADER_TOKEN ((int) 0xDEADC0DE)
+
+
+static inline int varint_size(unsigned int value)
+{
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline unsigned char* encode_varint(unsigned char* p, unsigned int value)
+{
+    while (value >= 0x80) {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    return p;
+}
+
+static inline unsigned int zigzag(int value)
+{
+    return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+// Sorted copy of a neighbor list; input lists are not guaranteed sorted.
+static void sorted_neighbors(const Vertex* begin, const Vertex* end, std::vector<Vertex>& out)
+{
+    out.assign(begin, end);
+    std::sort(out.begin(), out.end());
+}
+
+static size_t encoded_size(Vertex v, const Vertex* begin, const Vertex* end)
+{
+    size_t size = 0;
+    Vertex last = v;
+    for (const Vertex* u=begin; u!=end; u++) {
+        size += (u == begin) ? varint_size(zigzag(*u - v))
+                             : varint_size((unsigned int)(*u - last));
+        last = *u;
+    }
+    return size;
+}
+
+static void encode(unsigned char* p, Vertex v, const Vertex* begin, const Vertex* end)
+{
+    Vertex last = v;
+    for (const Vertex* u=begin; u!=end; u++) {
+        p = (u == begin) ? encode_varint(p, zigzag(*u - v))
+                         : encode_varint(p, (unsigned int)(*u - last));
+        last = *u;
+    }
+}
+
+static size_t num_blocks(int num_nodes)
+{
+    return ((size_t)num_nodes >> COMPRESSED_BLOCK_SHIFT) + 1;
+}
+
+static void alloc_offsets(compressed_lists* l, int num_nodes)
+{
+    l->block_offsets = (size_t*)malloc(sizeof(size_t) * num_blocks(num_nodes));
+    l->offsets = (unsigned int*)malloc(sizeof(unsigned int) * ((size_t)num_nodes + 1));
+    l->bytes = NULL;
+}
+
+// Records that vertex v's list starts pos bytes into the section.
+// Vertices must be visited in increasing order.
+static void set_offset(compressed_lists* l, Vertex v, size_t pos)
+{
+    size_t block = (size_t)v >> COMPRESSED_BLOCK_SHIFT;
+    if ((v & COMPRESSED_BLOCK_MASK) == 0)
+        l->block_offsets[block] = pos;
+
+    size_t relative = pos - l->block_offsets[block];
+    if (relative > UINT_MAX) {
+        fprintf(stderr, "Edges of a %d-vertex block exceed 32-bit offsets.\n", 1 << COMPRESSED_BLOCK_SHIFT);
+        exit(1);
+    }
+    l->offsets[v] = (unsigned int)relative;
+}
+
+// Two passes over one direction of the CSR: size every list, prefix
+// sum the sizes into offsets, then encode each list in place.
+static void compress_direction(const Graph g, bool outgoing, compressed_lists* l)
+{
+    int n = num_nodes(g);
+    std::vector<size_t> sizes(n);
+
+    #pragma omp parallel
+    {
+        std::vector<Vertex> neighbors;
+        #pragma omp for schedule(dynamic, 1024)
+        for (int v=0; v<n; v++) {
+            if (outgoing)
+                sorted_neighbors(outgoing_begin(g, v), outgoing_end(g, v), neighbors);
+            else
+                sorted_neighbors(incoming_begin(g, v), incoming_end(g, v), neighbors);
+            sizes[v] = encoded_size(v, neighbors.data(), neighbors.data() + neighbors.size());
+        }
+    }
+
+    alloc_offsets(l, n);
+    size_t pos = 0;
+    for (int v=0; v<n; v++) {
+        set_offset(l, v, pos);
+        pos += sizes[v];
+    }
+    set_offset(l, n, pos);
+
+    l->bytes = (unsigned char*)malloc(pos > 0 ? pos : 1);
+
+    #pragma omp parallel
+    {
+        std::vector<Vertex> neighbors;
+        #pragma omp for schedule(dynamic, 1024)
+        for (int v=0; v<n; v++) {
+            if (outgoing)
+                sorted_neighbors(outgoing_begin(g, v), outgoing_end(g, v), neighbors);
+            else
+                sorted_neighbors(incoming_begin(g, v), incoming_end(g, v), neighbors);
+            encode(l->bytes + list_offset(l, v), v, neighbors.data(), neighbors.data() + neighbors.size());
+        }
+    }
+}
+
+CompressedGraph compress_graph(const Graph g)
+{
+    compressed_graph* cg = (struct compressed_graph*)(malloc(sizeof(struct compressed_graph)));
+    cg->num_nodes = g->num_nodes;
+    cg->num_edges = g->num_edges;
+
+    compress_direction(g, true, &cg->outgoing);
+    compress_direction(g, false, &cg->incoming);
+
+    return cg;
+}
+
+static void free_lists(compressed_lists* l)
+{
+    free(l->block_offsets);
+    free(l->offsets);
+    free(l->bytes);
+}
+
+void free_compressed_graph(CompressedGraph cg)
+{
+    free_lists(&cg->outgoing);
+    free_lists(&cg->incoming);
+    free(cg);
+}
+
+size_t graph_bytes(const Graph g)
+{
+    return graph_bytes(g->num_nodes, g->num_edges);
+}
+
+size_t graph_bytes(int num_nodes, int num_edges)
+{
+    return 2 * (sizeof(int) * (size_t)num_nodes + sizeof(Vertex) * (size_t)num_edges);
+}
+
+static size_t offsets_bytes(int num_nodes)
+{
+    return sizeof(size_t) * num_blocks(num_nodes) + sizeof(unsigned int) * ((size_t)num_nodes + 1);
+}
+
+size_t compressed_graph_bytes(const CompressedGraph cg)
+{
+    return 2 * offsets_bytes(cg->num_nodes)
+        + list_offset(&cg->outgoing, cg->num_nodes)
+        + list_offset(&cg->incoming, cg->num_nodes);
+}
+
+static void read_or_die(void* buffer, size_t size, size_t count, FILE* input, const char* what)
+{
+    if (fread(buffer, size, count, input) != count) {
+        fprintf(stderr, "Error reading %s.\n", what);
+        exit(1);
+    }
+}
+
+static void write_or_die(const void* buffer, size_t size, size_t count, FILE* output, const char* what)
+{
+    if (fwrite(buffer, size, count, output) != count) {
+        fprintf(stderr, "Error writing %s.\n", what);
+        exit(1);
+    }
+}
+
+static void read_lists(compressed_lists* l, int num_nodes, FILE* input)
+{
+    alloc_offsets(l, num_nodes);
+    read_or_die(l->block_offsets, sizeof(size_t), num_blocks(num_nodes), input, "block offsets");
+    read_or_die(l->offsets, sizeof(unsigned int), (size_t)num_nodes + 1, input, "offsets");
+
+    size_t size = list_offset(l, num_nodes);
+    l->bytes = (unsigned char*)malloc(size + 1);
+    read_or_die(l->bytes, 1, size, input, "edges");
+}
+
+static void write_offsets(const compressed_lists* l, int num_nodes, FILE* output)
+{
+    write_or_die(l->block_offsets, sizeof(size_t), num_blocks(num_nodes), output, "block offsets");
+    write_or_die(l->offsets, sizeof(unsigned int), (size_t)num_nodes + 1, output, "offsets");
+}
+
+// Both directions are stored: rebuilding the incoming lists would need
+// the uncompressed graph in memory, which is what this format avoids.
+CompressedGraph load_compressed_graph_binary(const char* filename)
+{
+    FILE* input = fopen(filename, "rb");
+
+    if (!input) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    int header[3];
+    read_or_die(header, sizeof(int), 3, input, "header");
+
+    if (header[0] != COMPRESSED_GRAPH_HEADER_TOKEN) {
+        fprintf(stderr, "Invalid compressed graph file header. File may be corrupt.\n");
+        exit(1);
+    }
+
+    compressed_graph* cg = (struct compressed_graph*)(malloc(sizeof(struct compressed_graph)));
+    cg->num_nodes = header[1];
+    cg->num_edges = header[2];
+
+    read_lists(&cg->outgoing, cg->num_nodes, input);
+    read_lists(&cg->incoming, cg->num_nodes, input);
+
+    fclose(input);
+    return cg;
+}
+
+static FILE* open_compressed_output(const char* filename, int num_nodes, int num_edges)
+{
+    FILE* output = fopen(filename, "wb");
+
+    if (!output) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    int header[3];
+    header[0] = COMPRESSED_GRAPH_HEADER_TOKEN;
+    header[1] = num_nodes;
+    header[2] = num_edges;
+    write_or_die(header, sizeof(int), 3, output, "header");
+    return output;
+}
+
+void store_compressed_graph_binary(const char* filename, CompressedGraph cg)
+{
+    FILE* output = open_compressed_output(filename, cg->num_nodes, cg->num_edges);
+
+    write_offsets(&cg->outgoing, cg->num_nodes, output);
+    write_or_die(cg->outgoing.bytes, 1, list_offset(&cg->outgoing, cg->num_nodes), output, "outgoing edges");
+    write_offsets(&cg->incoming, cg->num_nodes, output);
+    write_or_die(cg->incoming.bytes, 1, list_offset(&cg->incoming, cg->num_nodes), output, "incoming edges");
+
+    fclose(output);
+}
+
+// Writes one direction of a compressed file as its lists are produced.
+// The offsets precede the bytes on disk but are only known once every
+// list is encoded, so their space is skipped and filled in at the end.
+struct list_writer
+{
+    FILE* output;
+    long offsets_pos;
+    compressed_lists lists;
+    size_t pos;
+    int num_nodes;
+};
+
+static void begin_lists(list_writer* w, FILE* output, int num_nodes)
+{
+    w->output = output;
+    w->offsets_pos = ftell(output);
+    alloc_offsets(&w->lists, num_nodes);
+    w->pos = 0;
+    w->num_nodes = num_nodes;
+    fseek(output, w->offsets_pos + offsets_bytes(num_nodes), SEEK_SET);
+}
+
+// Sorts, encodes and writes the lists of vertices [first, last).
+// Vertex first + i's list is edges[starts[i] - starts[0], starts[i + 1] - starts[0]).
+static void append_lists(list_writer* w, Vertex first, Vertex last, const size_t* starts, Vertex* edges)
+{
+    int count = last - first;
+    std::vector<size_t> local(count + 1);
+    local[0] = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i=0; i<count; i++) {
+        Vertex* begin = edges + (starts[i] - starts[0]);
+        Vertex* end = edges + (starts[i + 1] - starts[0]);
+        std::sort(begin, end);
+        local[i + 1] = encoded_size(first + i, begin, end);
+    }
+
+    for (int i=0; i<count; i++) {
+        set_offset(&w->lists, first + i, w->pos + local[i]);
+        local[i + 1] += local[i];
+    }
+
+    std::vector<unsigned char> bytes(local[count]);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i=0; i<count; i++) {
+        encode(bytes.data() + local[i], first + i,
+               edges + (starts[i] - starts[0]), edges + (starts[i + 1] - starts[0]));
+    }
+
+    write_or_die(bytes.data(), 1, bytes.size(), w->output, "edges");
+    w->pos += bytes.size();
+}
+
+static void end_lists(list_writer* w)
+{
+    set_offset(&w->lists, w->num_nodes, w->pos);
+
+    long end = ftell(w->output);
+    fseek(w->output, w->offsets_pos, SEEK_SET);
+    write_offsets(&w->lists, w->num_nodes, w->output);
+    fseek(w->output, end, SEEK_SET);
+    free_lists(&w->lists);
+}
+
+// Last vertex of the chunk that starts at first: the largest last with
+// starts[last] - starts[first] <= chunk_edges, or first + 1 when one
+// list alone is bigger than a chunk.
+static Vertex chunk_end(const std::vector<size_t>& starts, Vertex first, size_t chunk_edges)
+{
+    Vertex last = std::upper_bound(starts.begin() + first + 1, starts.end(),
+                                   starts[first] + chunk_edges) - starts.begin() - 1;
+    return std::max(last, first + 1);
+}
+
+size_t compress_graph_file(const char* graph_filename, const char* compressed_filename,
+                           size_t chunk_edges, int* num_nodes_out, int* num_edges_out)
+{
+    FILE* input = fopen(graph_filename, "rb");
+
+    if (!input) {
+        fprintf(stderr, "Could not open: %s\n", graph_filename);
+        exit(1);
+    }
+
+    int header[3];
+    read_or_die(header, sizeof(int), 3, input, "header");
+
+    if (header[0] != GRAPH_HEADER_TOKEN) {
+        fprintf(stderr, "Invalid graph file header. File may be corrupt.\n");
+        exit(1);
+    }
+
+    int n = header[1];
+    int m = header[2];
+    chunk_edges = std::max(chunk_edges, (size_t)1);
+
+    // Only per-vertex arrays are held in full; edges pass through a
+    // buffer of about chunk_edges at a time.
+    std::vector<int> file_starts(n);
+    read_or_die(file_starts.data(), sizeof(int), n, input, "nodes");
+    long edges_pos = ftell(input);
+
+    std::vector<size_t> out_starts(n + 1);
+    for (int v=0; v<n; v++)
+        out_starts[v] = file_starts[v];
+    out_starts[n] = m;
+    std::vector<int>().swap(file_starts);
+
+    std::vector<size_t> in_starts(n + 1, 0);
+    std::vector<Vertex> edges;
+
+    FILE* output = open_compressed_output(compressed_filename, n, m);
+
+    list_writer w;
+    begin_lists(&w, output, n);
+    for (Vertex first=0; first<n; ) {
+        Vertex last = chunk_end(out_starts, first, chunk_edges);
+        edges.resize(out_starts[last] - out_starts[first]);
+        read_or_die(edges.data(), sizeof(Vertex), edges.size(), input, "edges");
+
+        for (size_t i=0; i<edges.size(); i++) {
+            if (edges[i] < 0 || edges[i] >= n) {
+                fprintf(stderr, "Edge to vertex %d is out of range. File may be corrupt.\n", edges[i]);
+                exit(1);
+            }
+            in_starts[edges[i] + 1]++;
+        }
+
+        append_lists(&w, first, last, &out_starts[first], edges.data());
+        first = last;
+    }
+    end_lists(&w);
+    size_t compressed_bytes = w.pos;
+
+    for (int v=0; v<n; v++)
+        in_starts[v + 1] += in_starts[v];
+
+    // Each pass over the edges gathers the incoming lists of one range
+    // of destinations.  Sources are read in increasing order, so every
+    // gathered list comes out already sorted.
+    std::vector<Vertex> sources;
+    std::vector<size_t> fill;
+
+    begin_lists(&w, output, n);
+    for (Vertex first=0; first<n; ) {
+        Vertex last = chunk_end(in_starts, first, chunk_edges);
+        size_t base = in_starts[first];
+        sources.resize(in_starts[last] - base);
+        fill.assign(in_starts.begin() + first, in_starts.begin() + last);
+
+        fseek(input, edges_pos, SEEK_SET);
+        for (Vertex u_first=0; u_first<n; ) {
+            Vertex u_last = chunk_end(out_starts, u_first, chunk_edges);
+            edges.resize(out_starts[u_last] - out_starts[u_first]);
+            read_or_die(edges.data(), sizeof(Vertex), edges.size(), input, "edges");
+
+            const Vertex* e = edges.data();
+            for (Vertex u=u_first; u<u_last; u++) {
+                for (size_t i=out_starts[u]; i<out_starts[u + 1]; i++, e++) {
+                    if (*e >= first && *e < last)
+                        sources[fill[*e - first]++ - base] = u;
+                }
+            }
+            u_first = u_last;
+        }
+
+        append_lists(&w, first, last, &in_starts[first], sources.data());
+        first = last;
+    }
+    end_lists(&w);
+    compressed_bytes += w.pos;
+
+    fclose(input);
+    fclose(output);
+
+    *num_nodes_out = n;
+    *num_edges_out = m;
+    return 2 * offsets_bytes(n) + compressed_bytes;
+}
@@ -0,0 +1,122 @@
+#ifndef __COMPRESSED_GRAPH_H__
+#define __COMPRESSED_GRAPH_H__
+
+#include <stddef.h>
+
+#include "graph.h"
+
+// Adjacency lists stored as byte-aligned varints.  Every neighbor list
+// is sorted; its first neighbor is encoded as a zigzag delta from the
+// source vertex and every later neighbor as the gap to the previous
+// one.  Vertex v's bytes run from its offset to vertex v+1's, so no
+// degree array is needed: decoding stops at the next vertex's offset.
+//
+// Offsets are split in two to keep them small next to the edge bytes:
+// one 64-bit offset per block of 1 << COMPRESSED_BLOCK_SHIFT vertices,
+// and a 32-bit offset per vertex from the start of its block.
+#define COMPRESSED_BLOCK_SHIFT 6
+#define COMPRESSED_BLOCK_MASK ((1 << COMPRESSED_BLOCK_SHIFT) - 1)
+
+struct compressed_lists
+{
+    // (num_nodes >> COMPRESSED_BLOCK_SHIFT) + 1 entries
+    size_t* block_offsets;
+    // num_nodes + 1 entries, relative to the vertex's block
+    unsigned int* offsets;
+    unsigned char* bytes;
+};
+
+struct compressed_graph
+{
+    int num_edges;
+    int num_nodes;
+
+    compressed_lists outgoing;
+    compressed_lists incoming;
+};
+
+using CompressedGraph = compressed_graph*;
+
+// Walks one neighbor list without ever materializing it.
+struct neighbor_decoder
+{
+    const unsigned char* pos;
+    const unsigned char* end;
+    Vertex last;
+    bool first;
+};
+
+CompressedGraph compress_graph(const Graph);
+CompressedGraph load_compressed_graph_binary(const char* filename);
+void store_compressed_graph_binary(const char* filename, CompressedGraph);
+void free_compressed_graph(CompressedGraph);
+
+// Compresses a binary graph file straight to a compressed graph file
+// without loading the CSR: outgoing lists are streamed a chunk at a
+// time, and incoming lists are gathered for one range of destinations
+// per pass over the edges.  Each chunk holds about chunk_edges edges.
+// Returns the compressed size and the graph's node and edge counts.
+size_t compress_graph_file(const char* graph_filename, const char* compressed_filename,
+                           size_t chunk_edges, int* num_nodes, int* num_edges);
+
+// Bytes taken by the edge arrays of each representation, both directions
+size_t graph_bytes(const Graph);
+size_t graph_bytes(int num_nodes, int num_edges);
+size_t compressed_graph_bytes(const CompressedGraph);
+
+
+static inline unsigned int decode_varint(const unsigned char** pos)
+{
+    const unsigned char* p = *pos;
+    unsigned int value = *p & 0x7f;
+    int shift = 7;
+    while (*p++ & 0x80) {
+        value |= (unsigned int)(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    *pos = p;
+    return value;
+}
+
+static inline size_t list_offset(const compressed_lists* l, Vertex v)
+{
+    return l->block_offsets[v >> COMPRESSED_BLOCK_SHIFT] + l->offsets[v];
+}
+
+static inline void decoder_init(neighbor_decoder* d, const compressed_lists* l, Vertex v)
+{
+    d->pos = l->bytes + list_offset(l, v);
+    d->end = l->bytes + list_offset(l, v + 1);
+    d->last = v;
+    d->first = true;
+}
+
+static inline void outgoing_decoder(neighbor_decoder* d, const CompressedGraph g, Vertex v)
+{
+    decoder_init(d, &g->outgoing, v);
+}
+
+static inline void incoming_decoder(neighbor_decoder* d, const CompressedGraph g, Vertex v)
+{
+    decoder_init(d, &g->incoming, v);
+}
+
+// Stores the next neighbor in *out; returns false at the end of the list.
+static inline bool decoder_next(neighbor_decoder* d, Vertex* out)
+{
+    if (d->pos >= d->end)
+        return false;
+
+    unsigned int delta = decode_varint(&d->pos);
+    if (d->first) {
+        // zigzag: even values are non-negative, odd values negative
+        d->last += (delta & 1) ? -(int)(delta >> 1) - 1 : (int)(delta >> 1);
+        d->first = false;
+    } else {
+        d->last += (int)delta;
+    }
+    *out = d->last;
+    return true;
+}
+
+#endif
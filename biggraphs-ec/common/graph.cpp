@@ -3,12 +3,113 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "graph.h"
 #include "graph_internal.h"
 
-#define GRAPH_HEADER_TOKEN ((int) 0xDEADBEEF)
+#define PERMUTATION_HEADER_TOKEN ((int) 0xDEADF00D)
+// Marks the optional weight section that follows the edges
+#define GRAPH_WEIGHTS_TOKEN ((int) 0xDEADBEA7)
 
+#define SMALL_PAGE_SIZE (4096UL)
+#define HUGE_PAGE_SIZE (2UL << 20)
+// from <numaif.h>, which would pull in libnuma
+#define MPOL_INTERLEAVE 3
+
+
+// Bitmask of the online NUMA nodes, parsed from sysfs ("0-3,8").
+// Machines without NUMA support report a single node 0.
+static unsigned long online_numa_nodes()
+{
+    unsigned long mask = 0;
+    std::ifstream file("/sys/devices/system/node/online");
+    std::string ranges;
+    if (!std::getline(file, ranges))
+        return 1;
+
+    std::stringstream parser(ranges);
+    std::string range;
+    while (std::getline(parser, range, ',')) {
+        int first = 0, last = 0;
+        int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1)
+            continue;
+        if (fields == 1)
+            last = first;
+        for (int node = first; node <= last && node < (int)(8 * sizeof(mask)); node++)
+            mask |= 1UL << node;
+    }
+    return mask ? mask : 1;
+}
+
+void* graph_alloc(size_t bytes, alloc_policy policy)
+{
+    if (policy == ALLOC_MALLOC)
+        return malloc(bytes);
+
+    // mbind and madvise work on whole pages
+    size_t alignment = SMALL_PAGE_SIZE;
+    if (policy == ALLOC_HUGE_PAGES && bytes >= HUGE_PAGE_SIZE)
+        alignment = HUGE_PAGE_SIZE;
+
+    void* buffer;
+    if (posix_memalign(&buffer, alignment, bytes > 0 ? bytes : 1) != 0) {
+        fprintf(stderr, "Could not allocate %zu bytes.\n", bytes);
+        exit(1);
+    }
+
+    // Placement is only advice: on failure the memory behaves as if
+    // from malloc, so warn once and carry on.
+    static bool warned = false;
+
+    if (policy == ALLOC_FIRST_TOUCH) {
+        char* pages = (char*)buffer;
+        #pragma omp parallel for schedule(static)
+        for (size_t offset = 0; offset < bytes; offset += SMALL_PAGE_SIZE)
+            pages[offset] = 0;
+    } else if (policy == ALLOC_INTERLEAVE) {
+        unsigned long nodes = online_numa_nodes();
+        if (syscall(SYS_mbind, buffer, bytes, MPOL_INTERLEAVE, &nodes, 8 * sizeof(nodes) + 1, 0) != 0 && !warned) {
+            perror("mbind(MPOL_INTERLEAVE)");
+            warned = true;
+        }
+    } else if (policy == ALLOC_HUGE_PAGES && bytes >= HUGE_PAGE_SIZE) {
+        if (madvise(buffer, bytes, MADV_HUGEPAGE) != 0 && !warned) {
+            perror("madvise(MADV_HUGEPAGE)");
+            warned = true;
+        }
+    }
+
+    return buffer;
+}
+
+static const char* alloc_policy_names[] = { "malloc", "firsttouch", "interleave", "hugepages" };
+
+alloc_policy parse_alloc_policy(const char* name)
+{
+    for (int policy = ALLOC_MALLOC; policy <= ALLOC_HUGE_PAGES; policy++) {
+        if (!strcmp(name, alloc_policy_names[policy]))
+            return (alloc_policy)policy;
+    }
+    fprintf(stderr, "Unknown allocation policy: %s (expected malloc, firsttouch, interleave or hugepages)\n", name);
+    exit(1);
+}
+
+const char* alloc_policy_name(alloc_policy policy)
+{
+    return alloc_policy_names[policy];
+}
 
 void free_graph(Graph graph)
 {
@@ -17,6 +118,9 @@ void free_graph(Graph graph)
 
   free(graph->incoming_starts);
   free(graph->incoming_edges);
+
+  free(graph->outgoing_weights);
+  free(graph->incoming_weights);
   free(graph);
 }
 
@@ -43,7 +147,7 @@ void build_edges(graph* graph, int* scratch)
 
 // Given an outgoing edge adjacency list representation for a directed
 // graph, build an incoming adjacency list representation
-void build_incoming_edges(graph* graph) {
+void build_incoming_edges(graph* graph, alloc_policy policy) {
 
     //printf("Beginning build_incoming... (%d nodes)\n", graph->num_nodes);
 
@@ -51,8 +155,11 @@ void build_incoming_edges(graph* graph) {
     int* node_counts = (int*)malloc(sizeof(int) * num_nodes);
     int* node_scatter = (int*)malloc(sizeof(int) * num_nodes);
 
-    graph->incoming_starts = (int*)malloc(sizeof(int) * num_nodes);
-    graph->incoming_edges = (int*)malloc(sizeof(int) * graph->num_edges);
+    graph->incoming_starts = (int*)graph_alloc(sizeof(int) * num_nodes, policy);
+    graph->incoming_edges = (int*)graph_alloc(sizeof(int) * graph->num_edges, policy);
+    graph->incoming_weights = NULL;
+    if (graph->outgoing_weights)
+        graph->incoming_weights = (Weight*)graph_alloc(sizeof(Weight) * graph->num_edges, policy);
 
     for (int i=0; i<num_nodes; i++)
         node_counts[i] = node_scatter[i] = 0;
@@ -88,7 +195,10 @@ void build_incoming_edges(graph* graph) {
         int end_edge = (i == graph->num_nodes-1) ? graph->num_edges : graph->outgoing_starts[i+1];
         for (int j=start_edge; j<end_edge; j++) {
             int target_node = graph->outgoing_edges[j];
-            graph->incoming_edges[graph->incoming_starts[target_node] + node_scatter[target_node]] = i;
+            int slot = graph->incoming_starts[target_node] + node_scatter[target_node];
+            graph->incoming_edges[slot] = i;
+            if (graph->incoming_weights)
+                graph->incoming_weights[slot] = graph->outgoing_weights[j];
             node_scatter[target_node]++;
         }
     }
@@ -226,6 +336,7 @@ Graph load_graph(const char* filename)
 
   build_start(graph, scratch);
   build_edges(graph, scratch);
+  graph->outgoing_weights = NULL;
   free(scratch);
 
   build_incoming_edges(graph);
@@ -235,7 +346,265 @@ Graph load_graph(const char* filename)
   return graph;
 }
 
-Graph load_graph_binary(const char* filename)
+// Exclusive prefix sum of in[0..n) into out[0..n); returns the total.
+// Each thread scans one contiguous block, then adds the sum of the
+// blocks before it.  in and out may alias.
+static long parallel_exclusive_scan(const int* in, int* out, int n)
+{
+#ifdef _OPENMP
+    int num_threads = omp_get_max_threads();
+#else
+    int num_threads = 1;
+#endif
+    std::vector<long> block_sums(num_threads + 1, 0);
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+#ifdef _OPENMP
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+#else
+        int t = 0;
+        int threads = 1;
+#endif
+        int begin = (long)n * t / threads;
+        int end = (long)n * (t + 1) / threads;
+
+        long sum = 0;
+        for (int i=begin; i<end; i++)
+            sum += in[i];
+        block_sums[t + 1] = sum;
+
+        #pragma omp barrier
+        #pragma omp single
+        for (int i=1; i<=threads; i++)
+            block_sums[i] += block_sums[i - 1];
+
+        long running = block_sums[t];
+        for (int i=begin; i<end; i++) {
+            int count = in[i];
+            out[i] = running;
+            running += count;
+        }
+    }
+
+    return block_sums[num_threads];
+}
+
+// Parallel build_incoming_edges: count in-degrees atomically, scan them
+// into starts, scatter atomically, then sort each list so the sources
+// come out ascending exactly as in the serial scatter.
+static void build_incoming_edges_parallel(graph* graph)
+{
+    int num_nodes = graph->num_nodes;
+    int* node_scatter = (int*)malloc(sizeof(int) * num_nodes);
+
+    // only used for text graphs, which carry no weights
+    graph->incoming_weights = NULL;
+
+    graph->incoming_starts = (int*)malloc(sizeof(int) * num_nodes);
+    graph->incoming_edges = (int*)malloc(sizeof(int) * graph->num_edges);
+
+    #pragma omp parallel for
+    for (int i=0; i<num_nodes; i++)
+        graph->incoming_starts[i] = 0;
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i=0; i<num_nodes; i++) {
+        for (const Vertex* v=outgoing_begin(graph, i); v!=outgoing_end(graph, i); v++)
+            __sync_fetch_and_add(&graph->incoming_starts[*v], 1);
+    }
+
+    parallel_exclusive_scan(graph->incoming_starts, graph->incoming_starts, num_nodes);
+
+    #pragma omp parallel for
+    for (int i=0; i<num_nodes; i++)
+        node_scatter[i] = graph->incoming_starts[i];
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i=0; i<num_nodes; i++) {
+        for (const Vertex* v=outgoing_begin(graph, i); v!=outgoing_end(graph, i); v++)
+            graph->incoming_edges[__sync_fetch_and_add(&node_scatter[*v], 1)] = i;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i=0; i<num_nodes; i++)
+        std::sort(graph->incoming_edges + graph->incoming_starts[i],
+                  graph->incoming_edges + (i == num_nodes - 1 ? graph->num_edges : graph->incoming_starts[i + 1]));
+
+    free(node_scatter);
+}
+
+static inline const char* skip_line(const char* p, const char* end)
+{
+    const char* newline = (const char*)memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static inline bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Parses the integers in [p, end), which must start at a line start,
+// with the rules of read_graph_file: '#' lines are comments, and a
+// token that is not an integer ends its line.  Returns the number of
+// integers seen; they are stored only when STORE is set.
+template <bool STORE>
+static long parse_integers(const char* p, const char* end, int* out, long capacity)
+{
+    long count = 0;
+    while (p < end) {
+        if (*p == '#') {
+            p = skip_line(p, end);
+            continue;
+        }
+        while (p < end && *p != '\n') {
+            if (is_blank(*p)) {
+                p++;
+                continue;
+            }
+
+            bool negative = false;
+            if (*p == '-' || *p == '+') {
+                negative = (*p == '-');
+                p++;
+            }
+            if (p >= end || *p < '0' || *p > '9') {
+                p = skip_line(p, end) - 1;
+                break;
+            }
+
+            int value = 0;
+            while (p < end && *p >= '0' && *p <= '9')
+                value = value * 10 + (*p++ - '0');
+
+            if (STORE && count < capacity)
+                out[count] = negative ? -value : value;
+            count++;
+
+            if (p < end && *p != '\n' && !is_blank(*p)) {
+                p = skip_line(p, end) - 1;
+                break;
+            }
+        }
+        p++;
+    }
+    return count;
+}
+
+// Reads one header line the way get_meta_data does, skipping empty and
+// '#' lines, and advances *p past it.
+static void next_header_line(const char** p, const char* end, std::string& line)
+{
+    do {
+        if (*p >= end) {
+            line.clear();
+            return;
+        }
+        const char* start = *p;
+        *p = skip_line(start, end);
+        const char* stop = (*p > start && (*p)[-1] == '\n') ? *p - 1 : *p;
+        line.assign(start, stop);
+    } while (line.size() == 0 || line[0] == '#');
+}
+
+Graph load_graph_parallel(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    const char* data = (const char*)mmap(NULL, size > 0 ? size : 1, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Could not mmap: %s\n", filename);
+        exit(1);
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    const char* p = data;
+    const char* end = data + size;
+    std::string line;
+
+    const char* first = skip_line(p, end);
+    line.assign(p, (first > p && first[-1] == '\n') ? first - 1 : first);
+    p = first;
+    if (line.compare(std::string("AdjacencyGraph")))
+    {
+        std::cout << "Invalid input file" << line << std::endl;
+        exit(1);
+    }
+
+    graph* graph = (struct graph*)(malloc(sizeof(struct graph)));
+    next_header_line(&p, end, line);
+    graph->num_nodes = atoi(line.c_str());
+    next_header_line(&p, end, line);
+    graph->num_edges = atoi(line.c_str());
+
+    long total = (long)graph->num_nodes + graph->num_edges;
+    int* scratch = (int*)malloc(sizeof(int) * total);
+
+#ifdef _OPENMP
+    int num_chunks = omp_get_max_threads();
+#else
+    int num_chunks = 1;
+#endif
+
+    // chunk boundaries moved forward to the next line start
+    std::vector<const char*> bounds(num_chunks + 1);
+    bounds[0] = p;
+    bounds[num_chunks] = end;
+    for (int c=1; c<num_chunks; c++) {
+        const char* nominal = p + (end - p) * c / num_chunks;
+        bounds[c] = (nominal > p && nominal[-1] != '\n') ? skip_line(nominal, end) : nominal;
+        if (bounds[c] < bounds[c - 1])
+            bounds[c] = bounds[c - 1];
+    }
+
+    // count the integers in every chunk, scan the counts into write
+    // offsets, then parse again straight into scratch
+    std::vector<int> offsets(num_chunks);
+    #pragma omp parallel for schedule(static, 1)
+    for (int c=0; c<num_chunks; c++)
+        offsets[c] = parse_integers<false>(bounds[c], bounds[c + 1], NULL, 0);
+
+    parallel_exclusive_scan(offsets.data(), offsets.data(), num_chunks);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int c=0; c<num_chunks; c++) {
+        long offset = offsets[c];
+        if (offset < total)
+            parse_integers<true>(bounds[c], bounds[c + 1], scratch + offset, total - offset);
+    }
+
+    munmap((void*)data, size > 0 ? size : 1);
+    close(fd);
+
+    graph->outgoing_starts = (int*)malloc(sizeof(int) * graph->num_nodes);
+    graph->outgoing_edges = (int*)malloc(sizeof(int) * graph->num_edges);
+
+    #pragma omp parallel for
+    for (int i=0; i<graph->num_nodes; i++)
+        graph->outgoing_starts[i] = scratch[i];
+
+    #pragma omp parallel for
+    for (int i=0; i<graph->num_edges; i++)
+        graph->outgoing_edges[i] = scratch[graph->num_nodes + i];
+
+    free(scratch);
+
+    graph->outgoing_weights = NULL;
+    build_incoming_edges_parallel(graph);
+
+    return graph;
+}
+
+Graph load_graph_binary(const char* filename, alloc_policy policy)
 {
     graph* graph = (struct graph*)(malloc(sizeof(struct graph)));
 
@@ -261,8 +630,8 @@ Graph load_graph_binary(const char* filename)
     graph->num_nodes = header[1];
     graph->num_edges = header[2];
 
-    graph->outgoing_starts = (int*)malloc(sizeof(int) * graph->num_nodes);
-    graph->outgoing_edges = (int*)malloc(sizeof(int) * graph->num_edges);
+    graph->outgoing_starts = (int*)graph_alloc(sizeof(int) * graph->num_nodes, policy);
+    graph->outgoing_edges = (int*)graph_alloc(sizeof(int) * graph->num_edges, policy);
 
     if (fread(graph->outgoing_starts, sizeof(int), graph->num_nodes, input) != (size_t) graph->num_nodes) {
         fprintf(stderr, "Error reading nodes.\n");
@@ -274,9 +643,24 @@ Graph load_graph_binary(const char* filename)
         exit(1);
     }
 
+    // files written before weights existed simply end here
+    int weights_token;
+    graph->outgoing_weights = NULL;
+    if (fread(&weights_token, sizeof(int), 1, input) == 1) {
+        if (weights_token != GRAPH_WEIGHTS_TOKEN) {
+            fprintf(stderr, "Invalid weight section header. File may be corrupt.\n");
+            exit(1);
+        }
+        graph->outgoing_weights = (Weight*)graph_alloc(sizeof(Weight) * graph->num_edges, policy);
+        if (fread(graph->outgoing_weights, sizeof(Weight), graph->num_edges, input) != (size_t) graph->num_edges) {
+            fprintf(stderr, "Error reading weights.\n");
+            exit(1);
+        }
+    }
+
     fclose(input);
 
-    build_incoming_edges(graph);
+    build_incoming_edges(graph, policy);
     //print_graph(graph);
     return graph;
 }
@@ -310,5 +694,123 @@ void store_graph_binary(const char* filename, Graph graph) {
         exit(1);
     }
 
+    if (graph->outgoing_weights) {
+        int weights_token = GRAPH_WEIGHTS_TOKEN;
+        if (fwrite(&weights_token, sizeof(int), 1, output) != 1 ||
+            fwrite(graph->outgoing_weights, sizeof(Weight), graph->num_edges, output) != (size_t) graph->num_edges) {
+            fprintf(stderr, "Error writing weights.\n");
+            exit(1);
+        }
+    }
+
+    fclose(output);
+}
+
+Graph permute_graph(const Graph g, const Vertex* new_id)
+{
+    graph* permuted = (struct graph*)(malloc(sizeof(struct graph)));
+
+    int num_nodes = g->num_nodes;
+    permuted->num_nodes = num_nodes;
+    permuted->num_edges = g->num_edges;
+
+    int* old_id = (int*)malloc(sizeof(int) * num_nodes);
+    for (int i=0; i<num_nodes; i++)
+        old_id[new_id[i]] = i;
+
+    // new vertex i keeps the out-degree of the vertex it was renamed from
+    permuted->outgoing_starts = (int*)malloc(sizeof(int) * num_nodes);
+    permuted->outgoing_edges = (int*)malloc(sizeof(int) * g->num_edges);
+
+    permuted->outgoing_weights = NULL;
+    if (g->outgoing_weights)
+        permuted->outgoing_weights = (Weight*)malloc(sizeof(Weight) * g->num_edges);
+
+    // (target, weight) pairs, so weights follow their edge through the sort
+    std::vector<std::pair<Vertex, Weight>> neighbors;
+
+    int edge = 0;
+    for (int i=0; i<num_nodes; i++) {
+        permuted->outgoing_starts[i] = edge;
+        neighbors.clear();
+        for (const Vertex* v=outgoing_begin(g, old_id[i]); v!=outgoing_end(g, old_id[i]); v++) {
+            Weight w = g->outgoing_weights ? g->outgoing_weights[v - g->outgoing_edges] : 0;
+            neighbors.push_back(std::make_pair(new_id[*v], w));
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        for (size_t j=0; j<neighbors.size(); j++) {
+            permuted->outgoing_edges[edge] = neighbors[j].first;
+            if (permuted->outgoing_weights)
+                permuted->outgoing_weights[edge] = neighbors[j].second;
+            edge++;
+        }
+    }
+
+    free(old_id);
+
+    build_incoming_edges(permuted);
+    return permuted;
+}
+
+Vertex* load_permutation_binary(const char* filename, int num_nodes)
+{
+    FILE* input = fopen(filename, "rb");
+
+    if (!input) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    int header[2];
+
+    if (fread(header, sizeof(int), 2, input) != 2) {
+        fprintf(stderr, "Error reading permutation header.\n");
+        exit(1);
+    }
+
+    if (header[0] != PERMUTATION_HEADER_TOKEN) {
+        fprintf(stderr, "Invalid permutation file header. File may be corrupt.\n");
+        exit(1);
+    }
+
+    if (header[1] != num_nodes) {
+        fprintf(stderr, "Permutation has %d vertices, graph has %d.\n", header[1], num_nodes);
+        exit(1);
+    }
+
+    Vertex* new_id = (Vertex*)malloc(sizeof(Vertex) * num_nodes);
+
+    if (fread(new_id, sizeof(Vertex), num_nodes, input) != (size_t) num_nodes) {
+        fprintf(stderr, "Error reading permutation.\n");
+        exit(1);
+    }
+
+    fclose(input);
+    return new_id;
+}
+
+void store_permutation_binary(const char* filename, const Vertex* new_id, int num_nodes)
+{
+    FILE* output = fopen(filename, "wb");
+
+    if (!output) {
+        fprintf(stderr, "Could not open: %s\n", filename);
+        exit(1);
+    }
+
+    int header[2];
+    header[0] = PERMUTATION_HEADER_TOKEN;
+    header[1] = num_nodes;
+
+    if (fwrite(header, sizeof(int), 2, output) != 2) {
+        fprintf(stderr, "Error writing permutation header.\n");
+        exit(1);
+    }
+
+    if (fwrite(new_id, sizeof(Vertex), num_nodes, output) != (size_t) num_nodes) {
+        fprintf(stderr, "Error writing permutation.\n");
+        exit(1);
+    }
+
     fclose(output);
 }
@@ -1,7 +1,10 @@
 #ifndef __GRAPH_H__
 #define __GRAPH_H__
 
+#include <stddef.h>
+
 using Vertex = int;
+using Weight = int;
 
 struct graph
 {
@@ -18,6 +21,11 @@ struct graph
 
     int* incoming_starts;
     Vertex* incoming_edges;
+
+    // Optional non-negative edge weights, parallel to outgoing_edges
+    // and incoming_edges.  NULL for unweighted graphs.
+    Weight* outgoing_weights;
+    Weight* incoming_weights;
 };
 
 using Graph = graph*;
@@ -34,15 +42,64 @@ static inline const Vertex* incoming_begin(const Graph, Vertex);
 static inline const Vertex* incoming_end(const Graph, Vertex);
 static inline int incoming_size(const Graph, Vertex);
 
+// Weight of the edge at outgoing_begin(g, v) (resp. incoming_begin).
+// Only valid when the graph has weights.
+static inline const Weight* outgoing_weights_begin(const Graph, Vertex);
+static inline const Weight* incoming_weights_begin(const Graph, Vertex);
+
+
+/* Allocation */
+
+// Placement of the large per-vertex and per-edge arrays.
+enum alloc_policy {
+    // plain malloc: pages land on the node of the loading thread
+    ALLOC_MALLOC,
+    // every page is touched by the thread that a static OpenMP
+    // schedule assigns it to, before the loader fills it
+    ALLOC_FIRST_TOUCH,
+    // pages are spread round-robin over all online NUMA nodes
+    ALLOC_INTERLEAVE,
+    // 2MB-aligned and advised to transparent huge pages
+    ALLOC_HUGE_PAGES,
+};
+
+// Memory from graph_alloc is released with free().
+void* graph_alloc(size_t bytes, alloc_policy policy);
+// Accepts "malloc", "firsttouch", "interleave" and "hugepages".
+alloc_policy parse_alloc_policy(const char* name);
+const char* alloc_policy_name(alloc_policy policy);
+
 
 /* IO */
 Graph load_graph(const char* filename);
-Graph load_graph_binary(const char* filename);
+// Same result as load_graph, parsed by all threads from an mmap of the file
+Graph load_graph_parallel(const char* filename);
+// The CSR arrays in both directions (and weights) follow policy
+Graph load_graph_binary(const char* filename, alloc_policy policy = ALLOC_MALLOC);
 void store_graph_binary(const char* filename, Graph);
 
 void print_graph(const graph*);
 
 
+/* Relabeling */
+
+// Returns a copy of the graph in which vertex v is renamed to
+// new_id[v].  Neighbor lists of the new graph are sorted.
+Graph permute_graph(const Graph, const Vertex* new_id);
+
+// A permutation file stores new_id[] for every vertex of the
+// original graph, so results on a permuted graph can be mapped back.
+Vertex* load_permutation_binary(const char* filename, int num_nodes);
+void store_permutation_binary(const char* filename, const Vertex* new_id, int num_nodes);
+
+
+/* Construction */
+
+// Builds the incoming arrays (and incoming weights, if the graph has
+// weights) of a graph whose outgoing arrays are filled in.
+void build_incoming_edges(graph* graph, alloc_policy policy = ALLOC_MALLOC);
+
+
 /* Deallocation */
 void free_graph(Graph);
 
@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include "contracts.h"
 
+// First word of a binary graph file
+#define GRAPH_HEADER_TOKEN ((int) 0xDEADBEEF)
+
 static inline int num_nodes(const Graph graph)
 {
   REQUIRES(graph != NULL);
@@ -68,4 +71,18 @@ static inline int incoming_size(const Graph g, Vertex v)
   }
 }
 
+static inline const Weight* outgoing_weights_begin(const Graph g, Vertex v)
+{
+  REQUIRES(g != NULL && g->outgoing_weights != NULL);
+  REQUIRES(0 <= v && v < num_nodes(g));
+  return g->outgoing_weights + g->outgoing_starts[v];
+}
+
+static inline const Weight* incoming_weights_begin(const Graph g, Vertex v)
+{
+  REQUIRES(g != NULL && g->incoming_weights != NULL);
+  REQUIRES(0 <= v && v < num_nodes(g));
+  return g->incoming_weights + g->incoming_starts[v];
+}
+
 #endif // __GRAPH_INTERNAL_H__
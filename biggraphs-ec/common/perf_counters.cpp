@@ -0,0 +1,87 @@
+#include "perf_counters.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+
+const char* perf_counter_names[PERF_NUM_COUNTERS] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses",
+};
+
+static int open_counter(perf_counter_id id)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (id) {
+        case PERF_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            return -1;
+    }
+
+    // pid 0, cpu -1: the calling thread, on whichever CPU it runs
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : fd;
+}
+
+void perf_counters_open(perf_counters* counters)
+{
+    counters->num_threads = omp_get_max_threads();
+    counters->fds = (int*)malloc(sizeof(int) * counters->num_threads * PERF_NUM_COUNTERS);
+
+    #pragma omp parallel
+    {
+        int* fds = counters->fds + omp_get_thread_num() * PERF_NUM_COUNTERS;
+        for (int c = 0; c < PERF_NUM_COUNTERS; c++)
+            fds[c] = open_counter((perf_counter_id)c);
+    }
+}
+
+void perf_counters_close(perf_counters* counters)
+{
+    for (int i = 0; i < counters->num_threads * PERF_NUM_COUNTERS; i++)
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+    free(counters->fds);
+    counters->fds = NULL;
+}
+
+void perf_counters_read(const perf_counters* counters, long long values[PERF_NUM_COUNTERS])
+{
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        values[c] = -1;
+        for (int t = 0; t < counters->num_threads; t++) {
+            int fd = counters->fds[t * PERF_NUM_COUNTERS + c];
+            // value, time enabled, time running
+            unsigned long long data[3];
+            if (fd < 0 || read(fd, data, sizeof(data)) != sizeof(data))
+                continue;
+            double scale = (data[2] > 0) ? (double)data[1] / data[2] : 1.0;
+            values[c] = (values[c] < 0 ? 0 : values[c]) + (long long)(data[0] * scale);
+        }
+    }
+}
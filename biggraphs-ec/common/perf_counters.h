@@ -0,0 +1,37 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+// Hardware counters read through perf_event_open, summed over the
+// threads of the OpenMP team.  Counters the kernel or the CPU does not
+// provide (no PMU in a VM, perf_event_paranoid too high) read as -1.
+
+enum perf_counter_id {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_NUM_COUNTERS,
+};
+
+// Bytes moved per last-level cache miss, used to estimate DRAM reads.
+#define PERF_CACHE_LINE_BYTES 64
+
+struct perf_counters {
+    int num_threads;
+    // num_threads * PERF_NUM_COUNTERS descriptors, -1 when unavailable
+    int* fds;
+};
+
+// Opens the counters in every thread of a team of omp_get_max_threads()
+// threads.  A counter follows the thread that opened it, so later
+// parallel regions of the same size are counted as long as the OpenMP
+// runtime keeps its thread pool.
+void perf_counters_open(perf_counters* counters);
+void perf_counters_close(perf_counters* counters);
+
+// Current totals, scaled up when the kernel had to multiplex counters.
+void perf_counters_read(const perf_counters* counters, long long values[PERF_NUM_COUNTERS]);
+
+extern const char* perf_counter_names[PERF_NUM_COUNTERS];
+
+#endif
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "reorder.h"
+#include "graph_internal.h"
+
+static inline int total_degree(const Graph g, Vertex v)
+{
+    return outgoing_size(g, v) + incoming_size(g, v);
+}
+
+// Vertices sorted by total degree, ascending or descending.  The sort
+// is stable so ties keep their original relative order.
+static std::vector<Vertex> vertices_by_degree(const Graph g, bool descending)
+{
+    std::vector<Vertex> order(num_nodes(g));
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](Vertex a, Vertex b) {
+        int da = total_degree(g, a);
+        int db = total_degree(g, b);
+        return descending ? da > db : da < db;
+    });
+    return order;
+}
+
+void degree_sort_order(const Graph g, Vertex* new_id)
+{
+    std::vector<Vertex> order = vertices_by_degree(g, true);
+    for (int i=0; i<num_nodes(g); i++)
+        new_id[order[i]] = i;
+}
+
+void rcm_order(const Graph g, Vertex* new_id)
+{
+    int n = num_nodes(g);
+    std::vector<Vertex> seeds = vertices_by_degree(g, false);
+    std::vector<Vertex> order;
+    std::vector<Vertex> children;
+    std::vector<char> visited(n, 0);
+    order.reserve(n);
+
+    for (int s=0; s<n; s++) {
+        if (visited[seeds[s]])
+            continue;
+
+        // order[] doubles as the BFS queue of the current component
+        size_t head = order.size();
+        order.push_back(seeds[s]);
+        visited[seeds[s]] = 1;
+
+        while (head < order.size()) {
+            Vertex u = order[head++];
+
+            children.clear();
+            for (const Vertex* v=outgoing_begin(g, u); v!=outgoing_end(g, u); v++) {
+                if (!visited[*v]) {
+                    visited[*v] = 1;
+                    children.push_back(*v);
+                }
+            }
+            for (const Vertex* v=incoming_begin(g, u); v!=incoming_end(g, u); v++) {
+                if (!visited[*v]) {
+                    visited[*v] = 1;
+                    children.push_back(*v);
+                }
+            }
+
+            std::sort(children.begin(), children.end(), [&](Vertex a, Vertex b) {
+                int da = total_degree(g, a);
+                int db = total_degree(g, b);
+                return da != db ? da < db : a < b;
+            });
+            order.insert(order.end(), children.begin(), children.end());
+        }
+    }
+
+    for (int i=0; i<n; i++)
+        new_id[order[i]] = n - 1 - i;
+}
+
+void gorder_order(const Graph g, Vertex* new_id, int window)
+{
+    int n = num_nodes(g);
+
+    // Like Gorder, skip sibling updates through huge in-neighbors: they
+    // would touch most of the graph and say little about locality.
+    int hub_degree = std::max(window, (int)std::sqrt((double)n));
+
+    std::vector<int> score(n, 0);
+    std::vector<char> placed(n, 0);
+    std::vector<Vertex> order(n);
+    std::vector<Vertex> seeds = vertices_by_degree(g, true);
+    int next_seed = 0;
+
+    // Max-heap with lazy deletion.  Increments push a fresh entry;
+    // decrements are fixed up when a stale entry reaches the top.
+    std::priority_queue<std::pair<int, Vertex>> heap;
+
+    auto bump = [&](Vertex x, int delta) {
+        if (placed[x])
+            return;
+        score[x] += delta;
+        if (delta > 0)
+            heap.push(std::make_pair(score[x], x));
+    };
+
+    // Vertex u entering (+1) or leaving (-1) the window changes the
+    // score of its neighbors and of its siblings (shared in-neighbor).
+    auto update = [&](Vertex u, int delta) {
+        for (const Vertex* x=outgoing_begin(g, u); x!=outgoing_end(g, u); x++)
+            bump(*x, delta);
+        for (const Vertex* y=incoming_begin(g, u); y!=incoming_end(g, u); y++) {
+            bump(*y, delta);
+            if (outgoing_size(g, *y) > hub_degree)
+                continue;
+            for (const Vertex* x=outgoing_begin(g, *y); x!=outgoing_end(g, *y); x++) {
+                if (*x != u)
+                    bump(*x, delta);
+            }
+        }
+    };
+
+    for (int i=0; i<n; i++) {
+        Vertex v = -1;
+
+        while (!heap.empty()) {
+            std::pair<int, Vertex> top = heap.top();
+            heap.pop();
+            Vertex x = top.second;
+            if (placed[x] || top.first < score[x])
+                continue;
+            if (top.first > score[x]) {
+                if (score[x] > 0)
+                    heap.push(std::make_pair(score[x], x));
+                continue;
+            }
+            v = x;
+            break;
+        }
+
+        // nothing in the window relates to an unplaced vertex: start
+        // over from the highest-degree vertex left
+        if (v == -1) {
+            while (placed[seeds[next_seed]])
+                next_seed++;
+            v = seeds[next_seed];
+        }
+
+        placed[v] = 1;
+        new_id[v] = i;
+        order[i] = v;
+
+        update(v, 1);
+        if (i >= window)
+            update(order[i - window], -1);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef __REORDER_H__
+#define __REORDER_H__
+
+#include "graph.h"
+
+// Vertex relabeling heuristics.  Each one fills new_id[v] with the new
+// name of vertex v; the result can be applied with permute_graph().
+// Edges are treated as undirected (outgoing and incoming together).
+
+// Highest total degree first, ties broken by original id.
+void degree_sort_order(const Graph, Vertex* new_id);
+
+// Reverse Cuthill-McKee: BFS from a low-degree vertex of every
+// component, visiting neighbors by increasing degree, then reversed.
+void rcm_order(const Graph, Vertex* new_id);
+
+// Gorder-like greedy placement: the next vertex is the one sharing the
+// most neighbors and siblings with the last `window` placed vertices.
+void gorder_order(const Graph, Vertex* new_id, int window);
+
+#endif
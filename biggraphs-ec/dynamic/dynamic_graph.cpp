@@ -0,0 +1,245 @@
+#include "dynamic_graph.h"
+
+#include <stdlib.h>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+#include "../common/graph.h"
+
+#define NOT_VISITED_MARKER -1
+
+
+void dynamic_graph_init(dynamic_graph* dg, Graph base)
+{
+    dg->base = base;
+    dg->inserted.assign(base->num_nodes, std::vector<Vertex>());
+    dg->deleted.assign(base->num_nodes, std::vector<Vertex>());
+    dg->num_pending = 0;
+    dg->num_edges = base->num_edges;
+    dg->num_compactions = 0;
+}
+
+void dynamic_graph_free(dynamic_graph* dg)
+{
+    free_graph(dg->base);
+    dg->base = NULL;
+    dg->inserted.clear();
+    dg->deleted.clear();
+}
+
+static inline bool remove_one(std::vector<Vertex>& list, Vertex v)
+{
+    std::vector<Vertex>::iterator it = std::find(list.begin(), list.end(), v);
+    if (it == list.end())
+        return false;
+    *it = list.back();
+    list.pop_back();
+    return true;
+}
+
+static inline bool base_has_edge(Graph g, Vertex u, Vertex v)
+{
+    return std::find(outgoing_begin(g, u), outgoing_end(g, u), v) != outgoing_end(g, u);
+}
+
+// Applies one update to the lists of u, which only the calling thread
+// touches.  Adds the changes in edge and pending counts.
+static void apply_update(dynamic_graph* dg, const edge_update& update, long* edges, long* pending)
+{
+    Vertex u = update.src;
+    Vertex v = update.dst;
+    std::vector<Vertex>& inserted = dg->inserted[u];
+    std::vector<Vertex>& deleted = dg->deleted[u];
+
+    if (update.insert) {
+        if (remove_one(deleted, v)) {
+            (*edges)++;
+            (*pending)--;
+        } else if (std::find(inserted.begin(), inserted.end(), v) == inserted.end() &&
+                   !base_has_edge(dg->base, u, v)) {
+            inserted.push_back(v);
+            (*edges)++;
+            (*pending)++;
+        }
+    } else {
+        if (remove_one(inserted, v)) {
+            (*edges)--;
+            (*pending)--;
+        } else if (std::find(deleted.begin(), deleted.end(), v) == deleted.end() &&
+                   base_has_edge(dg->base, u, v)) {
+            deleted.push_back(v);
+            (*edges)--;
+            (*pending)++;
+        }
+    }
+}
+
+void dynamic_graph_apply(dynamic_graph* dg, const edge_update* updates, int count)
+{
+    // group by source, keeping batch order within a source
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return updates[a].src < updates[b].src; });
+
+    std::vector<int> group_starts;
+    for (int i = 0; i < count; i++)
+        if (i == 0 || updates[order[i]].src != updates[order[i - 1]].src)
+            group_starts.push_back(i);
+    group_starts.push_back(count);
+
+    long edges = 0;
+    long pending = 0;
+    int num_groups = group_starts.size() - 1;
+
+    #pragma omp parallel for schedule(dynamic, 16) reduction(+:edges, pending)
+    for (int group = 0; group < num_groups; group++) {
+        for (int i = group_starts[group]; i < group_starts[group + 1]; i++)
+            apply_update(dg, updates[order[i]], &edges, &pending);
+    }
+
+    dg->num_edges += edges;
+    dg->num_pending += pending;
+
+    if (dg->num_pending > DYNAMIC_COMPACT_FRACTION * dg->base->num_edges)
+        dynamic_graph_compact(dg);
+}
+
+void dynamic_graph_compact(dynamic_graph* dg)
+{
+    int n = dg->base->num_nodes;
+
+    graph* g = (struct graph*)(malloc(sizeof(struct graph)));
+    g->num_nodes = n;
+    g->outgoing_starts = (int*)malloc(sizeof(int) * n);
+    g->outgoing_weights = NULL;
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < n; u++) {
+        // counted rather than derived from the list sizes, since a
+        // deletion drops every copy of a duplicated base edge
+        int size = 0;
+        dynamic_graph_for_each_outgoing(dg, u, [&](Vertex) { size++; });
+        g->outgoing_starts[u] = size;
+    }
+
+    int total = 0;
+    for (int u = 0; u < n; u++) {
+        int size = g->outgoing_starts[u];
+        g->outgoing_starts[u] = total;
+        total += size;
+    }
+    g->num_edges = total;
+    g->outgoing_edges = (Vertex*)malloc(sizeof(Vertex) * (total > 0 ? total : 1));
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int u = 0; u < n; u++) {
+        Vertex* out = g->outgoing_edges + g->outgoing_starts[u];
+        dynamic_graph_for_each_outgoing(dg, u, [&](Vertex v) { *out++ = v; });
+        dg->inserted[u].clear();
+        dg->deleted[u].clear();
+    }
+
+    build_incoming_edges(g);
+
+    free_graph(dg->base);
+    dg->base = g;
+    dg->num_edges = total;
+    dg->num_pending = 0;
+    dg->num_compactions++;
+}
+
+// Lowers distances[v] to new_dist if v is unreached or further away.
+// Returns whether this call made the change.
+static inline bool lower_distance(int* distances, Vertex v, int new_dist)
+{
+    int old_dist = distances[v];
+    while (old_dist == NOT_VISITED_MARKER || new_dist < old_dist) {
+        if (__sync_bool_compare_and_swap(&distances[v], old_dist, new_dist))
+            return true;
+        old_dist = distances[v];
+    }
+    return false;
+}
+
+// Relaxes the outgoing edges of every frontier vertex until no
+// distance changes.  A vertex may be expanded again if it is lowered
+// again later; every expansion uses its distance at that time.
+static void propagate(const dynamic_graph* dg, std::vector<Vertex>& frontier, int* distances)
+{
+    std::vector<Vertex> next;
+
+    while (!frontier.empty()) {
+        next.clear();
+
+        #pragma omp parallel
+        {
+            std::vector<Vertex> local;
+
+            #pragma omp for schedule(dynamic, 64) nowait
+            for (size_t i = 0; i < frontier.size(); i++) {
+                int new_dist = distances[frontier[i]] + 1;
+                dynamic_graph_for_each_outgoing(dg, frontier[i], [&](Vertex v) {
+                    if (lower_distance(distances, v, new_dist))
+                        local.push_back(v);
+                });
+            }
+
+            #pragma omp critical
+            next.insert(next.end(), local.begin(), local.end());
+        }
+
+        frontier.swap(next);
+    }
+}
+
+void dynamic_bfs(const dynamic_graph* dg, Vertex root, int* distances)
+{
+    #pragma omp parallel for
+    for (int i = 0; i < dg->base->num_nodes; i++)
+        distances[i] = NOT_VISITED_MARKER;
+
+    // from a single root every vertex is first reached at its final
+    // distance, so this is an ordinary level-by-level search
+    distances[root] = 0;
+    std::vector<Vertex> frontier(1, root);
+    propagate(dg, frontier, distances);
+}
+
+// Whether u -> v is in the current graph.
+static bool has_edge(const dynamic_graph* dg, Vertex u, Vertex v)
+{
+    const std::vector<Vertex>& inserted = dg->inserted[u];
+    const std::vector<Vertex>& deleted = dg->deleted[u];
+    if (std::find(inserted.begin(), inserted.end(), v) != inserted.end())
+        return true;
+    return std::find(deleted.begin(), deleted.end(), v) == deleted.end() && base_has_edge(dg->base, u, v);
+}
+
+bool dynamic_bfs_update(const dynamic_graph* dg, Vertex root, const edge_update* updates, int count,
+                        int* distances)
+{
+    for (int i = 0; i < count; i++) {
+        const edge_update& update = updates[i];
+        int dist_src = distances[update.src];
+        if (!update.insert && dist_src != NOT_VISITED_MARKER && distances[update.dst] == dist_src + 1) {
+            dynamic_bfs(dg, root, distances);
+            return false;
+        }
+    }
+
+    std::vector<Vertex> frontier;
+    for (int i = 0; i < count; i++) {
+        const edge_update& update = updates[i];
+        int dist_src = distances[update.src];
+        // skip insertions undone later in the batch
+        if (update.insert && dist_src != NOT_VISITED_MARKER && has_edge(dg, update.src, update.dst) &&
+            lower_distance(distances, update.dst, dist_src + 1))
+            frontier.push_back(update.dst);
+    }
+
+    propagate(dg, frontier, distances);
+    return true;
+}
@@ -0,0 +1,69 @@
+#ifndef __DYNAMIC_GRAPH_H__
+#define __DYNAMIC_GRAPH_H__
+
+#include <algorithm>
+#include <vector>
+
+#include "common/graph.h"
+
+// Pending updates, as a fraction of the base edges, past which
+// dynamic_graph_apply folds them into a new CSR.
+#define DYNAMIC_COMPACT_FRACTION 0.1
+
+// A mutable graph: an immutable CSR base plus, for every vertex, the
+// outgoing edges inserted and the base edges deleted since the last
+// compaction.  The graph is a set of edges: inserting an existing edge
+// or deleting a missing one does nothing.  Weights are not tracked.
+struct dynamic_graph {
+  Graph base;
+  std::vector<std::vector<Vertex>> inserted;
+  std::vector<std::vector<Vertex>> deleted;
+  long num_pending;
+  long num_edges;
+  int num_compactions;
+};
+
+struct edge_update {
+  Vertex src;
+  Vertex dst;
+  bool insert;
+};
+
+// Takes ownership of base.
+void dynamic_graph_init(dynamic_graph* dg, Graph base);
+void dynamic_graph_free(dynamic_graph* dg);
+
+// Applies a batch in order, in parallel across source vertices, then
+// compacts if the pending updates exceed DYNAMIC_COMPACT_FRACTION.
+void dynamic_graph_apply(dynamic_graph* dg, const edge_update* updates, int count);
+
+// Rebuilds the base CSR with every pending update folded in.
+void dynamic_graph_compact(dynamic_graph* dg);
+
+// Calls f(v) for every current outgoing neighbor v of u.
+template <typename F>
+static inline void dynamic_graph_for_each_outgoing(const dynamic_graph* dg, Vertex u, F f)
+{
+    const std::vector<Vertex>& deleted = dg->deleted[u];
+    for (const Vertex* v = outgoing_begin(dg->base, u); v != outgoing_end(dg->base, u); v++) {
+        if (!deleted.empty() && std::find(deleted.begin(), deleted.end(), *v) != deleted.end())
+            continue;
+        f(*v);
+    }
+    for (Vertex v : dg->inserted[u])
+        f(v);
+}
+
+// Level-synchronous top-down BFS over the current graph.  Unreached
+// vertices get -1, as in the BFS solutions.
+void dynamic_bfs(const dynamic_graph* dg, Vertex root, int* distances);
+
+// Brings distances, the result of an earlier search from root, up to
+// date with a batch that has already been applied.  Insertions only
+// lower distances, so the search restarts from the vertices they
+// improve.  A deletion of an edge that may be on a shortest path
+// falls back to dynamic_bfs.  Returns false when it had to recompute.
+bool dynamic_bfs_update(const dynamic_graph* dg, Vertex root, const edge_update* updates, int count,
+                        int* distances);
+
+#endif
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "bfs/bfs.h"
+#include "dynamic_graph.h"
+
+#define DEFAULT_BATCH_SIZE 1000
+#define DEFAULT_NUM_BATCHES 20
+#define DEFAULT_DELETE_PERCENT 0
+
+void usage(const char* binary_name) {
+    std::cout << "Usage: " << binary_name << " [options] graphfile [num_threads]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -b  INT updates per batch (default " << DEFAULT_BATCH_SIZE << ")" << std::endl;
+    std::cout << "  -n  INT number of batches (default " << DEFAULT_NUM_BATCHES << ")" << std::endl;
+    std::cout << "  -d  INT percentage of updates that delete an edge (default " << DEFAULT_DELETE_PERCENT << ")" << std::endl;
+    std::cout << "  -h      this commandline help message" << std::endl;
+}
+
+// Random insertions between uniform endpoints, and deletions of random
+// current base edges.
+void random_batch(const dynamic_graph* dg, std::mt19937& rng, int size, int delete_percent,
+                  std::vector<edge_update>& batch) {
+    std::uniform_int_distribution<int> pick(0, dg->base->num_nodes - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    batch.clear();
+    while ((int)batch.size() < size) {
+        edge_update update;
+        update.src = pick(rng);
+        update.insert = percent(rng) >= delete_percent;
+        if (update.insert) {
+            update.dst = pick(rng);
+        } else {
+            int degree = outgoing_size(dg->base, update.src);
+            if (degree == 0)
+                continue;
+            update.dst = outgoing_begin(dg->base, update.src)[rng() % degree];
+        }
+        batch.push_back(update);
+    }
+}
+
+bool same_distances(const char* name, const int* result, const int* expected, int n) {
+    for (int j = 0; j < n; j++) {
+        if (result[j] != expected[j]) {
+            fprintf(stderr, "*** %s disagrees at %d: %d, expected %d\n", name, j, result[j], expected[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    int batch_size = DEFAULT_BATCH_SIZE;
+    int num_batches = DEFAULT_NUM_BATCHES;
+    int delete_percent = DEFAULT_DELETE_PERCENT;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:d:h")) != EOF) {
+        switch (opt) {
+            case 'b':
+                batch_size = std::max(atoi(optarg), 1);
+                break;
+            case 'n':
+                num_batches = std::max(atoi(optarg), 1);
+                break;
+            case 'd':
+                delete_percent = std::min(std::max(atoi(optarg), 0), 100);
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (argc <= optind) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc > optind + 1)
+        thread_count = atoi(argv[optind + 1]);
+
+    std::string graph_filename = argv[optind];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("----------------------------------------------------------\n");
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Updates/s     Incremental  Recompute  Speedup  Fallbacks  Compactions\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++)
+    {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        // every thread count replays the same updates on a fresh graph
+        dynamic_graph dg;
+        dynamic_graph_init(&dg, load_graph_binary(graph_filename.c_str()));
+        int n = dg.base->num_nodes;
+        std::mt19937 rng(149);
+
+        int* distances = (int*)malloc(sizeof(int) * n);
+        int* recomputed = (int*)malloc(sizeof(int) * n);
+        dynamic_bfs(&dg, ROOT_NODE_ID, distances);
+
+        double apply_time = 0, incremental_time = 0, recompute_time = 0;
+        int fallbacks = 0;
+        std::vector<edge_update> batch;
+
+        for (int b = 0; b < num_batches; b++) {
+            random_batch(&dg, rng, batch_size, delete_percent, batch);
+
+            double start = CycleTimer::currentSeconds();
+            dynamic_graph_apply(&dg, batch.data(), batch.size());
+            apply_time += CycleTimer::currentSeconds() - start;
+
+            start = CycleTimer::currentSeconds();
+            if (!dynamic_bfs_update(&dg, ROOT_NODE_ID, batch.data(), batch.size(), distances))
+                fallbacks++;
+            incremental_time += CycleTimer::currentSeconds() - start;
+
+            start = CycleTimer::currentSeconds();
+            dynamic_bfs(&dg, ROOT_NODE_ID, recomputed);
+            recompute_time += CycleTimer::currentSeconds() - start;
+
+            check = same_distances("Incremental BFS", distances, recomputed, n) && check;
+        }
+
+        // the overlay must describe the same graph once compacted
+        std::cout << "Testing Correctness of Incremental BFS\n";
+        dynamic_graph_compact(&dg);
+        solution sol;
+        sol.distances = recomputed;
+        bfs_hybrid(dg.base, &sol, ROOT_NODE_ID);
+        check = same_distances("Incremental BFS", distances, recomputed, n) && check;
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3e     %7.3f    %7.3f    %5.2fx     %4d       %4d\n",
+                num_threads[i], (double)num_batches * batch_size / apply_time,
+                incremental_time, recompute_time, recompute_time / incremental_time,
+                fallbacks, dg.num_compactions - 1);
+        timing << buf;
+
+        free(recomputed);
+        free(distances);
+        dynamic_graph_free(&dg);
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << num_batches << " batches of " << batch_size << " updates ("
+              << delete_percent << "% deletions): Timing Summary" << std::endl;
+    std::cout << timing.str();
+    printf("----------------------------------------------------------\n");
+    if (!check)
+        std::cout << "Incremental BFS does not match a full search" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <cmath>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "page_rank.h"
+
+int main(int argc, char** argv) {
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
+        std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+        std::cerr << "  Run with a certain number of threads: <path/to/graph/file> <num_threads>\n";
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc == 3)
+    {
+        thread_count = atoi(argv[2]);
+    }
+
+    std::string graph_filename = argv[1];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("----------------------------------------------------------\n");
+
+    printf("Loading graph...\n");
+    Graph g = load_graph_binary(graph_filename.c_str());
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d\n", g->num_edges);
+    printf("  Nodes: %d\n", g->num_nodes);
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    double* pull_sol = (double*)malloc(sizeof(double) * g->num_nodes);
+    double* push_sol = (double*)malloc(sizeof(double) * g->num_nodes);
+
+    double pull_base = 0, push_base = 0;
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Pull              Push              Iterations\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++)
+    {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        double start = CycleTimer::currentSeconds();
+        int pull_iterations = page_rank_pull(g, pull_sol);
+        double pull_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        int push_iterations = page_rank_push(g, push_sol);
+        double push_time = CycleTimer::currentSeconds() - start;
+
+        // the kernels add in different orders, so only agree up to the
+        // convergence threshold
+        std::cout << "Testing Correctness of Push against Pull\n";
+        double max_diff = 0.0;
+        for (int j = 0; j < g->num_nodes; j++)
+            max_diff = std::max(max_diff, std::fabs(pull_sol[j] - push_sol[j]));
+        if (max_diff > PAGE_RANK_CONVERGENCE) {
+            fprintf(stderr, "*** Results disagree by up to %g\n", max_diff);
+            check = false;
+        }
+
+        if (i == 0)
+        {
+            pull_base = pull_time;
+            push_base = push_time;
+        }
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3f (%.2fx)     %.3f (%.2fx)     %d / %d\n",
+                num_threads[i], pull_time, pull_base/pull_time,
+                push_time, push_base/push_time, pull_iterations, push_iterations);
+        timing << buf;
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "PageRank: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    printf("----------------------------------------------------------\n");
+    if (!check)
+        std::cout << "Push PageRank does not match Pull PageRank" << std::endl;
+
+    free(pull_sol);
+    free(push_sol);
+    free_graph(g);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "page_rank.h"
+
+#include <stdlib.h>
+#include <cmath>
+#include <omp.h>
+
+#include "../common/graph.h"
+
+
+// 1/out-degree of every vertex, 0 for vertices without outgoing
+// edges, so the per-iteration scaling is one vectorizable multiply.
+static double* inverse_out_degrees(Graph g)
+{
+    int n = num_nodes(g);
+    double* inverse = (double*)malloc(sizeof(double) * n);
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++) {
+        int degree = outgoing_size(g, v);
+        inverse[v] = (degree == 0) ? 0.0 : 1.0 / degree;
+    }
+    return inverse;
+}
+
+// contribution[v] = score[v] / out-degree(v).  Returns the total score
+// held by dangling vertices (those with no outgoing edges).
+static double scale_contributions(Graph g, const double* score, const double* inverse_degree,
+                                  double* contribution)
+{
+    int n = num_nodes(g);
+    double dangling = 0.0;
+
+    #pragma omp parallel for simd
+    for (int v = 0; v < n; v++)
+        contribution[v] = score[v] * inverse_degree[v];
+
+    #pragma omp parallel for reduction(+:dangling)
+    for (int v = 0; v < n; v++) {
+        if (outgoing_size(g, v) == 0)
+            dangling += score[v];
+    }
+    return dangling;
+}
+
+// new_score[v] = base + damping * gathered[v], in place.  Returns the
+// L1 norm of new_score - score.
+static double apply_damping(int n, const double* score, double* new_score, double base, double damping)
+{
+    double diff = 0.0;
+
+    #pragma omp parallel for simd reduction(+:diff)
+    for (int v = 0; v < n; v++) {
+        new_score[v] = base + damping * new_score[v];
+        diff += std::fabs(new_score[v] - score[v]);
+    }
+    return diff;
+}
+
+int page_rank_pull(Graph g, double* solution, double damping, double convergence, int max_iterations)
+{
+    int n = num_nodes(g);
+    double* inverse_degree = inverse_out_degrees(g);
+    double* contribution = (double*)malloc(sizeof(double) * n);
+    double* new_score = (double*)malloc(sizeof(double) * n);
+    double* score = solution;
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++)
+        score[v] = 1.0 / n;
+
+    int iteration = 0;
+    while (iteration < max_iterations) {
+        double dangling = scale_contributions(g, score, inverse_degree, contribution);
+
+        #pragma omp parallel for schedule(dynamic, 512)
+        for (int v = 0; v < n; v++) {
+            double sum = 0.0;
+            for (const Vertex* u = incoming_begin(g, v), *end = incoming_end(g, v); u < end; ++u)
+                sum += contribution[*u];
+            new_score[v] = sum;
+        }
+
+        double base = (1.0 - damping) / n + damping * dangling / n;
+        double diff = apply_damping(n, score, new_score, base, damping);
+
+        double* temp = score;
+        score = new_score;
+        new_score = temp;
+        iteration++;
+
+        if (diff < convergence)
+            break;
+    }
+
+    // after an odd number of swaps the result is in the scratch array
+    if (score != solution) {
+        #pragma omp parallel for
+        for (int v = 0; v < n; v++)
+            solution[v] = score[v];
+        new_score = score;
+    }
+
+    free(inverse_degree);
+    free(contribution);
+    free(new_score);
+    return iteration;
+}
+
+int page_rank_push(Graph g, double* solution, double damping, double convergence, int max_iterations)
+{
+    int n = num_nodes(g);
+    double* inverse_degree = inverse_out_degrees(g);
+    double* contribution = (double*)malloc(sizeof(double) * n);
+    double* new_score = (double*)malloc(sizeof(double) * n);
+    double* score = solution;
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++)
+        score[v] = 1.0 / n;
+
+    int iteration = 0;
+    while (iteration < max_iterations) {
+        double dangling = scale_contributions(g, score, inverse_degree, contribution);
+
+        #pragma omp parallel for
+        for (int v = 0; v < n; v++)
+            new_score[v] = 0.0;
+
+        #pragma omp parallel for schedule(dynamic, 512)
+        for (int u = 0; u < n; u++) {
+            double c = contribution[u];
+            for (const Vertex* v = outgoing_begin(g, u), *end = outgoing_end(g, u); v < end; ++v) {
+                #pragma omp atomic
+                new_score[*v] += c;
+            }
+        }
+
+        double base = (1.0 - damping) / n + damping * dangling / n;
+        double diff = apply_damping(n, score, new_score, base, damping);
+
+        double* temp = score;
+        score = new_score;
+        new_score = temp;
+        iteration++;
+
+        if (diff < convergence)
+            break;
+    }
+
+    // after an odd number of swaps the result is in the scratch array
+    if (score != solution) {
+        #pragma omp parallel for
+        for (int v = 0; v < n; v++)
+            solution[v] = score[v];
+        new_score = score;
+    }
+
+    free(inverse_degree);
+    free(contribution);
+    free(new_score);
+    return iteration;
+}
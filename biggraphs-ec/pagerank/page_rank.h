@@ -0,0 +1,27 @@
+#ifndef __PAGE_RANK_H__
+#define __PAGE_RANK_H__
+
+#include "common/graph.h"
+
+#define PAGE_RANK_DAMPING 0.85
+#define PAGE_RANK_CONVERGENCE 1e-7
+#define PAGE_RANK_MAX_ITERATIONS 100
+
+// Both kernels compute the same ranks into solution[num_nodes] and
+// return the number of iterations run.  They stop once the L1 norm of
+// the change between two iterations drops below convergence.  The
+// rank of vertices without outgoing edges is spread over all vertices.
+
+// Pull: every vertex sums the contributions of its incoming edges.
+// Each score is written by one thread only, so no atomics are needed.
+int page_rank_pull(Graph g, double* solution, double damping = PAGE_RANK_DAMPING,
+                   double convergence = PAGE_RANK_CONVERGENCE,
+                   int max_iterations = PAGE_RANK_MAX_ITERATIONS);
+
+// Push: every vertex adds its contribution along its outgoing edges,
+// with atomic adds since several sources may share a target.
+int page_rank_push(Graph g, double* solution, double damping = PAGE_RANK_DAMPING,
+                   double convergence = PAGE_RANK_CONVERGENCE,
+                   int max_iterations = PAGE_RANK_MAX_ITERATIONS);
+
+#endif
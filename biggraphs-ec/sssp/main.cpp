@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "bfs/bfs.h"
+#include "sssp.h"
+
+void usage(const char* binary_name) {
+    std::cout << "Usage: " << binary_name << " [options] graphfile [num_threads]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -d  INT delta-stepping bucket width (default " << SSSP_DEFAULT_DELTA << ")" << std::endl;
+    std::cout << "  -s  INT source vertex (default " << ROOT_NODE_ID << ")" << std::endl;
+    std::cout << "  -h      this commandline help message" << std::endl;
+}
+
+bool same_distances(const char* name, const int* result, const int* expected, int n) {
+    for (int j = 0; j < n; j++) {
+        if (result[j] != expected[j]) {
+            fprintf(stderr, "*** %s disagrees at %d: %d, expected %d\n", name, j, result[j], expected[j]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    int delta = SSSP_DEFAULT_DELTA;
+    Vertex source = ROOT_NODE_ID;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:s:h")) != EOF) {
+        switch (opt) {
+            case 'd':
+                delta = std::max(atoi(optarg), 1);
+                break;
+            case 's':
+                source = atoi(optarg);
+                break;
+            case 'h':
+            case '?':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (argc <= optind) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc > optind + 1)
+    {
+        thread_count = atoi(argv[optind + 1]);
+    }
+
+    std::string graph_filename = argv[optind];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("----------------------------------------------------------\n");
+
+    printf("Loading graph...\n");
+    Graph g = load_graph_binary(graph_filename.c_str());
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d\n", g->num_edges);
+    printf("  Nodes: %d\n", g->num_nodes);
+    printf("  Weights: %s\n", g->outgoing_weights ? "yes" : "no (all edges weigh 1)");
+
+    if (source < 0 || source >= g->num_nodes) {
+        fprintf(stderr, "Source %d is not a vertex of the graph.\n", source);
+        exit(1);
+    }
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    int* ds_dist = (int*)malloc(sizeof(int) * g->num_nodes);
+    int* bf_dist = (int*)malloc(sizeof(int) * g->num_nodes);
+    int* unit_dist = (int*)malloc(sizeof(int) * g->num_nodes);
+    solution sol;
+    sol.distances = (int*)malloc(sizeof(int) * g->num_nodes);
+    bfs_workspace ws;
+    bfs_workspace_init(&ws, g->num_nodes);
+
+    double ds_base = 0, bf_base = 0, unit_base = 0, bfs_base = 0;
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Delta-Step        Bellman-Ford      BF Rounds  Unit Delta-Step   BFS Hybrid\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++)
+    {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        double start = CycleTimer::currentSeconds();
+        sssp_delta_stepping(g, g->outgoing_weights, source, ds_dist, delta);
+        double ds_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        int rounds = sssp_bellman_ford(g, g->outgoing_weights, source, bf_dist);
+        double bf_time = CycleTimer::currentSeconds() - start;
+
+        // with unit weights delta = 1 processes exactly one BFS level
+        // per bucket
+        start = CycleTimer::currentSeconds();
+        sssp_delta_stepping(g, NULL, source, unit_dist, 1);
+        double unit_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        bfs_hybrid(g, &sol, source, &ws);
+        double bfs_time = CycleTimer::currentSeconds() - start;
+
+        std::cout << "Testing Correctness of Delta-Stepping\n";
+        check = same_distances("Delta-stepping", ds_dist, bf_dist, g->num_nodes) && check;
+        std::cout << "Testing Correctness of Unit-Weight Delta-Stepping\n";
+        check = same_distances("Unit-weight delta-stepping", unit_dist, sol.distances, g->num_nodes) && check;
+
+        if (i == 0)
+        {
+            ds_base = ds_time;
+            bf_base = bf_time;
+            unit_base = unit_time;
+            bfs_base = bfs_time;
+        }
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3f (%.2fx)     %.3f (%.2fx)     %5d      %.3f (%.2fx)     %.3f (%.2fx)\n",
+                num_threads[i], ds_time, ds_base/ds_time, bf_time, bf_base/bf_time, rounds,
+                unit_time, unit_base/unit_time, bfs_time, bfs_base/bfs_time);
+        timing << buf;
+    }
+
+    printf("----------------------------------------------------------\n");
+    std::cout << "SSSP from " << source << " (delta = " << delta << "): Timing Summary" << std::endl;
+    std::cout << timing.str();
+    printf("----------------------------------------------------------\n");
+    if (!check)
+        std::cout << "Delta-stepping does not match its baselines" << std::endl;
+
+    bfs_workspace_free(&ws);
+    free(sol.distances);
+    free(unit_dist);
+    free(bf_dist);
+    free(ds_dist);
+    free_graph(g);
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+// sssp_delta_stepping is adapted from DeltaStep in the GAP Benchmark
+// Suite (GAPBS, https://github.com/sbeamer/gapbs, src/sssp.cc), whose
+// license follows:
+//
+// Copyright (c) 2015, The Regents of the University of California (Regents)
+// All Rights Reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the Regents nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL REGENTS AND CONTRIBUTORS BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sssp.h"
+
+#include <stdlib.h>
+#include <climits>
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+#include "../common/graph.h"
+
+#define SSSP_INFINITY INT_MAX
+
+
+static inline Weight edge_weight(const Weight* weights, int edge)
+{
+    return weights ? weights[edge] : 1;
+}
+
+// Lowers distances[v] to new_dist unless another thread got it lower
+// first.  Returns whether this call made the improvement.
+static inline bool atomic_min(int* distances, Vertex v, int new_dist)
+{
+    int old_dist = distances[v];
+    while (new_dist < old_dist) {
+        if (__sync_bool_compare_and_swap(&distances[v], old_dist, new_dist))
+            return true;
+        old_dist = distances[v];
+    }
+    return false;
+}
+
+// Converts unreached vertices to the -1 the BFS solutions use.
+static void finish_distances(Graph g, int* distances)
+{
+    #pragma omp parallel for
+    for (int v = 0; v < g->num_nodes; v++) {
+        if (distances[v] == SSSP_INFINITY)
+            distances[v] = -1;
+    }
+}
+
+static void init_distances(Graph g, Vertex source, int* distances)
+{
+    #pragma omp parallel for
+    for (int v = 0; v < g->num_nodes; v++)
+        distances[v] = SSSP_INFINITY;
+    distances[source] = 0;
+}
+
+// Relaxes the outgoing edges of u and files every improved neighbor
+// into this thread's bucket for its new distance.
+static void relax_edges(Graph g, const Weight* weights, Vertex u, int delta, int* distances,
+                        std::vector<std::vector<Vertex>>& local_bins)
+{
+    int start_edge = g->outgoing_starts[u];
+    int end_edge = (u == g->num_nodes - 1) ? g->num_edges : g->outgoing_starts[u + 1];
+    int dist_u = distances[u];
+
+    for (int edge = start_edge; edge < end_edge; edge++) {
+        Vertex v = g->outgoing_edges[edge];
+        int new_dist = dist_u + edge_weight(weights, edge);
+        if (atomic_min(distances, v, new_dist)) {
+            size_t bin = new_dist / delta;
+            if (bin >= local_bins.size())
+                local_bins.resize(bin + 1);
+            local_bins[bin].push_back(v);
+        }
+    }
+}
+
+// Delta-stepping with thread-local buckets and bucket fusion, after
+// GAPBS DeltaStep (see the license at the top of this file).
+void sssp_delta_stepping(Graph g, const Weight* weights, Vertex source, int* distances, int delta)
+{
+    init_distances(g, source, distances);
+
+    // A vertex enters a bucket once per improvement, and every
+    // improvement comes from a distinct edge, so no bucket is larger
+    // than num_edges + 1.
+    Vertex* frontier = (Vertex*)malloc(sizeof(Vertex) * ((size_t)g->num_edges + 1));
+    frontier[0] = source;
+
+    // Index of the current bucket and size of the frontier, double
+    // buffered by iteration parity so the next values can be agreed on
+    // while the current ones are still being read.
+    const size_t no_bin = (size_t)-1;
+    size_t shared_indexes[2] = { 0, no_bin };
+    size_t frontier_tails[2] = { 1, 0 };
+
+    #pragma omp parallel
+    {
+        std::vector<std::vector<Vertex>> local_bins;
+        size_t iter = 0;
+
+        while (shared_indexes[iter & 1] != no_bin) {
+            size_t& curr_bin_index = shared_indexes[iter & 1];
+            size_t& next_bin_index = shared_indexes[(iter + 1) & 1];
+            size_t& curr_frontier_tail = frontier_tails[iter & 1];
+            size_t& next_frontier_tail = frontier_tails[(iter + 1) & 1];
+
+            // Skip stale entries: vertices that were lowered into an
+            // earlier bucket after being filed here have been settled.
+            #pragma omp for nowait schedule(dynamic, 64)
+            for (size_t i = 0; i < curr_frontier_tail; i++) {
+                Vertex u = frontier[i];
+                if ((size_t)distances[u] >= (size_t)delta * curr_bin_index)
+                    relax_edges(g, weights, u, delta, distances, local_bins);
+            }
+
+            // bucket fusion: keep going on small local work
+            while (curr_bin_index < local_bins.size() &&
+                   !local_bins[curr_bin_index].empty() &&
+                   local_bins[curr_bin_index].size() < SSSP_BIN_SIZE_THRESHOLD) {
+                std::vector<Vertex> curr_bin_copy;
+                curr_bin_copy.swap(local_bins[curr_bin_index]);
+                for (Vertex u : curr_bin_copy)
+                    relax_edges(g, weights, u, delta, distances, local_bins);
+            }
+
+            for (size_t i = curr_bin_index; i < local_bins.size(); i++) {
+                if (!local_bins[i].empty()) {
+                    #pragma omp critical
+                    next_bin_index = std::min(next_bin_index, i);
+                    break;
+                }
+            }
+
+            #pragma omp barrier
+            #pragma omp single nowait
+            {
+                curr_bin_index = no_bin;
+                curr_frontier_tail = 0;
+            }
+
+            if (next_bin_index < local_bins.size()) {
+                std::vector<Vertex>& bin = local_bins[next_bin_index];
+                size_t copy_start = __sync_fetch_and_add(&next_frontier_tail, bin.size());
+                std::copy(bin.begin(), bin.end(), frontier + copy_start);
+                bin.clear();
+            }
+
+            iter++;
+            #pragma omp barrier
+        }
+    }
+
+    free(frontier);
+    finish_distances(g, distances);
+}
+
+int sssp_bellman_ford(Graph g, const Weight* weights, Vertex source, int* distances)
+{
+    init_distances(g, source, distances);
+
+    int rounds = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        #pragma omp parallel for schedule(dynamic, 1024) reduction(||:changed)
+        for (int u = 0; u < g->num_nodes; u++) {
+            int dist_u = distances[u];
+            if (dist_u == SSSP_INFINITY)
+                continue;
+            int start_edge = g->outgoing_starts[u];
+            int end_edge = (u == g->num_nodes - 1) ? g->num_edges : g->outgoing_starts[u + 1];
+            for (int edge = start_edge; edge < end_edge; edge++) {
+                if (atomic_min(distances, g->outgoing_edges[edge], dist_u + edge_weight(weights, edge)))
+                    changed = true;
+            }
+        }
+        rounds++;
+    }
+
+    finish_distances(g, distances);
+    return rounds;
+}
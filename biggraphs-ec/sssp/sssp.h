@@ -0,0 +1,31 @@
+#ifndef __SSSP_H__
+#define __SSSP_H__
+
+#include "common/graph.h"
+
+// Bucket width used when none is given.  Suits weights of a few
+// hundred on graphs of average degree ~10-20; unit weights want 1.
+#define SSSP_DEFAULT_DELTA 32
+// A thread keeps relaxing its own copy of the current bucket while it
+// stays below this size, instead of waiting at a barrier for the other
+// threads (bucket fusion, as in GAPBS; see sssp.cpp).
+#define SSSP_BIN_SIZE_THRESHOLD 1000
+
+// Single-source shortest paths over the outgoing edges.  weights is
+// parallel to g->outgoing_edges (e.g. g->outgoing_weights) and must be
+// non-negative; NULL means every edge has weight 1.  On return
+// distances[v] is the length of the shortest path from source to v,
+// or -1 if v is unreachable, like the BFS solutions.
+
+// Delta-stepping: vertices are processed in buckets of width delta.
+// Every thread files the vertices it improves into its own bucket
+// array; the threads then agree on the next non-empty bucket and copy
+// their part of it into a shared frontier.
+void sssp_delta_stepping(Graph g, const Weight* weights, Vertex source, int* distances,
+                         int delta = SSSP_DEFAULT_DELTA);
+
+// Baseline: relaxes every edge of every vertex until no distance
+// changes.  Returns the number of rounds.
+int sssp_bellman_ford(Graph g, const Weight* weights, Vertex source, int* distances);
+
+#endif
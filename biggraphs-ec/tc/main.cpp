@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include <string>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "common/CycleTimer.h"
+#include "common/graph.h"
+#include "tc.h"
+
+int main(int argc, char** argv) {
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: <path/to/graph/file> [num_threads]\n";
+        std::cerr << "  To run results for all thread counts: <path/to/graph/file>\n";
+        std::cerr << "  Run with a certain number of threads: <path/to/graph/file> <num_threads>\n";
+        exit(1);
+    }
+
+    int thread_count = -1;
+    if (argc == 3)
+    {
+        thread_count = atoi(argv[2]);
+    }
+
+    std::string graph_filename = argv[1];
+
+    printf("----------------------------------------------------------\n");
+    printf("Max system threads = %d\n", omp_get_max_threads());
+    printf("AVX2 intersection = %s\n", __builtin_cpu_supports("avx2") ? "yes" : "no");
+    printf("----------------------------------------------------------\n");
+
+    printf("Loading graph...\n");
+    Graph g = load_graph_binary(graph_filename.c_str());
+    printf("\n");
+    printf("Graph stats:\n");
+    printf("  Edges: %d\n", g->num_edges);
+    printf("  Nodes: %d\n", g->num_nodes);
+
+    std::vector<int> num_threads;
+    if (thread_count > 0) {
+        num_threads.push_back(std::min(thread_count, omp_get_max_threads()));
+    } else {
+        for (int i = 1; i < omp_get_max_threads(); i *= 2)
+            num_threads.push_back(i);
+        num_threads.push_back(omp_get_max_threads());
+    }
+
+    double orient_base = 0, simd_base = 0, scalar_base = 0;
+    long triangles = 0;
+    bool check = true;
+    std::stringstream timing;
+    timing << "Threads  Orient            Count             Count (scalar)\n";
+
+    for (size_t i = 0; i < num_threads.size(); i++)
+    {
+        printf("----------------------------------------------------------\n");
+        std::cout << "Running with " << num_threads[i] << " threads" << std::endl;
+        omp_set_num_threads(num_threads[i]);
+
+        double start = CycleTimer::currentSeconds();
+        Graph dag = orient_by_degree(g);
+        double orient_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        triangles = count_triangles(dag);
+        double simd_time = CycleTimer::currentSeconds() - start;
+
+        start = CycleTimer::currentSeconds();
+        long scalar_triangles = count_triangles_scalar(dag);
+        double scalar_time = CycleTimer::currentSeconds() - start;
+
+        std::cout << "Testing Correctness of Triangle Count\n";
+        if (triangles != scalar_triangles) {
+            fprintf(stderr, "*** Results disagree: %ld, %ld\n", triangles, scalar_triangles);
+            check = false;
+        }
+
+        if (i == 0)
+        {
+            orient_base = orient_time;
+            simd_base = simd_time;
+            scalar_base = scalar_time;
+        }
+
+        char buf[1024];
+        sprintf(buf, "%4d:    %.3f (%.2fx)     %.3f (%.2fx)     %.3f (%.2fx)\n",
+                num_threads[i], orient_time, orient_base/orient_time,
+                simd_time, simd_base/simd_time, scalar_time, scalar_base/scalar_time);
+        timing << buf;
+
+        free_graph(dag);
+    }
+
+    printf("----------------------------------------------------------\n");
+    printf("Triangles: %ld\n", triangles);
+    std::cout << "Triangle Counting: Timing Summary" << std::endl;
+    std::cout << timing.str();
+    printf("----------------------------------------------------------\n");
+    if (!check)
+        std::cout << "SIMD count does not match scalar count" << std::endl;
+
+    free_graph(g);
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "tc.h"
+
+#include <stdlib.h>
+#include <omp.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <vector>
+
+#include "../common/graph.h"
+
+
+// Position in the orientation order: by undirected degree, then id.
+static inline bool ranks_below(const int* degree, Vertex u, Vertex v)
+{
+    return degree[u] < degree[v] || (degree[u] == degree[v] && u < v);
+}
+
+// Sorted, duplicate- and self-loop-free neighbors of u that rank above it.
+static void higher_neighbors(Graph g, const int* degree, Vertex u, std::vector<Vertex>& out)
+{
+    out.clear();
+    for (const Vertex* v = outgoing_begin(g, u); v < outgoing_end(g, u); v++)
+        if (ranks_below(degree, u, *v))
+            out.push_back(*v);
+    for (const Vertex* v = incoming_begin(g, u); v < incoming_end(g, u); v++)
+        if (ranks_below(degree, u, *v))
+            out.push_back(*v);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+Graph orient_by_degree(Graph g)
+{
+    int n = num_nodes(g);
+    int* degree = (int*)malloc(sizeof(int) * n);
+
+    #pragma omp parallel for
+    for (int v = 0; v < n; v++)
+        degree[v] = outgoing_size(g, v) + incoming_size(g, v);
+
+    graph* dag = (struct graph*)(malloc(sizeof(struct graph)));
+    dag->num_nodes = n;
+    dag->outgoing_starts = (int*)malloc(sizeof(int) * n);
+    dag->incoming_starts = NULL;
+    dag->incoming_edges = NULL;
+    dag->outgoing_weights = NULL;
+    dag->incoming_weights = NULL;
+
+    // size every list, prefix sum, then fill
+    #pragma omp parallel
+    {
+        std::vector<Vertex> neighbors;
+        #pragma omp for schedule(dynamic, 1024)
+        for (int u = 0; u < n; u++) {
+            higher_neighbors(g, degree, u, neighbors);
+            dag->outgoing_starts[u] = neighbors.size();
+        }
+    }
+
+    int total = 0;
+    for (int u = 0; u < n; u++) {
+        int size = dag->outgoing_starts[u];
+        dag->outgoing_starts[u] = total;
+        total += size;
+    }
+    dag->num_edges = total;
+    dag->outgoing_edges = (Vertex*)malloc(sizeof(Vertex) * (total > 0 ? total : 1));
+
+    #pragma omp parallel
+    {
+        std::vector<Vertex> neighbors;
+        #pragma omp for schedule(dynamic, 1024)
+        for (int u = 0; u < n; u++) {
+            higher_neighbors(g, degree, u, neighbors);
+            std::copy(neighbors.begin(), neighbors.end(), dag->outgoing_edges + dag->outgoing_starts[u]);
+        }
+    }
+
+    free(degree);
+    return dag;
+}
+
+static long intersect_scalar(const Vertex* a, const Vertex* a_end, const Vertex* b, const Vertex* b_end)
+{
+    long count = 0;
+    while (a < a_end && b < b_end) {
+        if (*a < *b) {
+            a++;
+        } else if (*b < *a) {
+            b++;
+        } else {
+            count++;
+            a++;
+            b++;
+        }
+    }
+    return count;
+}
+
+// Compares 8 elements of a against 8 of b (all rotations of the b
+// block), then advances whichever block has the smaller maximum.  The
+// lists are duplicate-free, so every lane of a matches at most once.
+__attribute__((target("avx2")))
+static long intersect_avx2(const Vertex* a, const Vertex* a_end, const Vertex* b, const Vertex* b_end)
+{
+    long count = 0;
+    const __m256i rotate = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+
+    while (a_end - a >= 8 && b_end - b >= 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)a);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+        __m256i match = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rotate);
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+        }
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(match)));
+
+        Vertex a_max = a[7];
+        Vertex b_max = b[7];
+        if (a_max <= b_max)
+            a += 8;
+        if (b_max <= a_max)
+            b += 8;
+    }
+    return count + intersect_scalar(a, a_end, b, b_end);
+}
+
+template <long (*INTERSECT)(const Vertex*, const Vertex*, const Vertex*, const Vertex*)>
+static long count_with(Graph dag)
+{
+    long triangles = 0;
+
+    // a few hubs have far longer lists than the rest, so chunks are small
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:triangles)
+    for (int u = 0; u < dag->num_nodes; u++) {
+        const Vertex* u_begin = outgoing_begin(dag, u);
+        const Vertex* u_end = outgoing_end(dag, u);
+        for (const Vertex* v = u_begin; v < u_end; v++)
+            triangles += INTERSECT(u_begin, u_end, outgoing_begin(dag, *v), outgoing_end(dag, *v));
+    }
+    return triangles;
+}
+
+long count_triangles(Graph dag)
+{
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        return count_with<intersect_avx2>(dag);
+    return count_with<intersect_scalar>(dag);
+}
+
+long count_triangles_scalar(Graph dag)
+{
+    return count_with<intersect_scalar>(dag);
+}
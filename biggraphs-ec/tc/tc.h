@@ -0,0 +1,22 @@
+#ifndef __TC_H__
+#define __TC_H__
+
+#include "common/graph.h"
+
+// Triangles of the undirected graph underlying g: edge directions,
+// duplicate edges and self loops are ignored.
+
+// Keeps every undirected edge once, pointing from its lower-degree end
+// to its higher-degree end (ties broken by id), with sorted lists.
+// Each triangle then appears exactly once, as u -> v -> w with u -> w,
+// and no list is longer than sqrt(2 * num_edges).  The result only has
+// outgoing edges; release it with free_graph.
+Graph orient_by_degree(Graph g);
+
+// Sum over every oriented edge u -> v of |out(u) & out(v)|.  The
+// default kernel intersects lists with AVX2 when the CPU has it.
+long count_triangles(Graph dag);
+// Same count with a plain scalar merge.
+long count_triangles_scalar(Graph dag);
+
+#endif
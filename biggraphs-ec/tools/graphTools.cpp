@@ -8,6 +8,8 @@
 
 
 #include "../common/graph.h"
+#include "../common/reorder.h"
+#include "../common/compressed_graph.h"
 
 #define CMD_TEXT2BIN    "text2bin"
 #define CMD_INFO        "info"
@@ -15,6 +17,158 @@
 #define CMD_NOOUTEDGES  "noout"
 #define CMD_NOINEDGES   "noin"
 #define CMD_EDGESTATS   "edgestats"
+#define CMD_DEGREESORT  "degreesort"
+#define CMD_RCM         "rcm"
+#define CMD_GORDER      "gorder"
+#define CMD_COMPRESS    "compress"
+#define CMD_WEIGHTS     "weights"
+#define CMD_GENERATE    "generate"
+
+#define GORDER_DEFAULT_WINDOW 5
+#define WEIGHTS_DEFAULT_MAX   255
+#define WEIGHTS_DEFAULT_SEED  149
+#define GENERATE_DEFAULT_EDGEFACTOR 16
+#define GENERATE_DEFAULT_SEED 149
+// edges held in memory at once while compressing (128 MB of Vertex)
+#define COMPRESS_DEFAULT_CHUNK_EDGES (32UL << 20)
+
+// Graph500 R-MAT quadrant probabilities (D = 1 - A - B - C = 0.05)
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+// splitmix64 finalizer: a stateless hash, so random values can be
+// computed from a counter by any thread in any order.
+static inline unsigned long long mix64(unsigned long long x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Weight of the edge {u, v} in [1, max_weight].  A hash of the
+// unordered endpoint pair, so both directions of a symmetric edge get
+// the same weight and the result does not depend on thread count.
+static Weight edge_weight(Vertex u, Vertex v, int max_weight, unsigned int seed) {
+    unsigned long long x = ((unsigned long long)std::min(u, v) << 32) | (unsigned int)std::max(u, v);
+    x += 0x9E3779B97F4A7C15ULL * (seed + 1);
+    return 1 + (Weight)(mix64(x) % (unsigned long long)max_weight);
+}
+
+// A seeded bijection on [0, 2^scale): odd multiplies carry low bits
+// up, xor-shifts carry high bits down.  Scatters the R-MAT hubs, which
+// would otherwise all have small ids, without storing a permutation.
+static Vertex scramble_vertex(unsigned long long v, int scale, unsigned long long seed) {
+    unsigned long long mask = (1ULL << scale) - 1;
+    for (int round = 0; round < 4; round++) {
+        unsigned long long key = mix64(seed + round);
+        v = (v * (key | 1)) & mask;
+        v ^= v >> ((scale + 1) / 2);
+        v = (v + (key >> 32)) & mask;
+    }
+    return (Vertex)v;
+}
+
+// Endpoints of R-MAT edge number index: at every level one quadrant
+// of the adjacency matrix is chosen from a hash of (index, level).
+// Both endpoints go through the same relabeling, like the single
+// vertex permutation of Graph500, so hubs and self loops survive it.
+static void rmat_edge(unsigned long long index, int scale, unsigned long long seed, Vertex* u, Vertex* v) {
+    unsigned long long src = 0, dst = 0;
+    for (int level = 0; level < scale; level++) {
+        double r = (mix64(seed ^ (index * scale + level)) >> 11) * (1.0 / 9007199254740992.0);
+        src <<= 1;
+        dst <<= 1;
+        if (r < RMAT_A) {
+        } else if (r < RMAT_A + RMAT_B) {
+            dst |= 1;
+        } else if (r < RMAT_A + RMAT_B + RMAT_C) {
+            src |= 1;
+        } else {
+            src |= 1;
+            dst |= 1;
+        }
+    }
+    *u = scramble_vertex(src, scale, seed);
+    *v = scramble_vertex(dst, scale, seed);
+}
+
+// Exclusive prefix sum of counts[0..n) into starts[0..n]; returns the total.
+static long exclusive_scan(const int* counts, int* starts, int n) {
+    long total = 0;
+    for (int i = 0; i < n; i++) {
+        starts[i] = total;
+        total += counts[i];
+    }
+    starts[n] = total;
+    return total;
+}
+
+// Symmetric R-MAT graph with edgefactor << scale generated edges, each
+// stored in both directions, without self loops or duplicates.  Every
+// step is parallel and the output only depends on scale, edgefactor and
+// seed.
+static Graph generate_rmat(int scale, int edgefactor, unsigned int seed) {
+    int n = 1 << scale;
+    long num_generated = (long)edgefactor << scale;
+    unsigned long long key = mix64(seed + 0x9E3779B97F4A7C15ULL);
+
+    // count both directions of every edge, then scatter them
+    int* degree = (int*)calloc(n, sizeof(int));
+    #pragma omp parallel for schedule(static)
+    for (long e = 0; e < num_generated; e++) {
+        Vertex u, v;
+        rmat_edge(e, scale, key, &u, &v);
+        if (u == v)
+            continue;
+        __sync_fetch_and_add(&degree[u], 1);
+        __sync_fetch_and_add(&degree[v], 1);
+    }
+
+    int* starts = (int*)malloc(sizeof(int) * (n + 1));
+    long total = exclusive_scan(degree, starts, n);
+    Vertex* edges = (Vertex*)malloc(sizeof(Vertex) * (total > 0 ? total : 1));
+
+    #pragma omp parallel for
+    for (int u = 0; u < n; u++)
+        degree[u] = starts[u];
+
+    #pragma omp parallel for schedule(static)
+    for (long e = 0; e < num_generated; e++) {
+        Vertex u, v;
+        rmat_edge(e, scale, key, &u, &v);
+        if (u == v)
+            continue;
+        edges[__sync_fetch_and_add(&degree[u], 1)] = v;
+        edges[__sync_fetch_and_add(&degree[v], 1)] = u;
+    }
+
+    // the scatter order depends on the threads; sorting the lists
+    // makes the result deterministic and exposes duplicates
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int u = 0; u < n; u++) {
+        std::sort(edges + starts[u], edges + starts[u + 1]);
+        degree[u] = std::unique(edges + starts[u], edges + starts[u + 1]) - (edges + starts[u]);
+    }
+
+    graph* g = (struct graph*)(malloc(sizeof(struct graph)));
+    g->num_nodes = n;
+    g->outgoing_starts = (int*)malloc(sizeof(int) * (n + 1));
+    g->num_edges = exclusive_scan(degree, g->outgoing_starts, n);
+    g->outgoing_edges = (Vertex*)malloc(sizeof(Vertex) * (g->num_edges > 0 ? g->num_edges : 1));
+    g->incoming_starts = NULL;
+    g->incoming_edges = NULL;
+    g->outgoing_weights = NULL;
+    g->incoming_weights = NULL;
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int u = 0; u < n; u++)
+        std::copy(edges + starts[u], edges + starts[u] + degree[u], g->outgoing_edges + g->outgoing_starts[u]);
+
+    free(edges);
+    free(starts);
+    free(degree);
+    return g;
+}
 
 
 void print_help(const char* binary_name) {
@@ -27,7 +181,13 @@ void print_help(const char* binary_name) {
               << CMD_PRINT << ": print graph topology (careful with big graphs)\n"
               << CMD_NOOUTEDGES << ": detect vertices with no outgoing edges\n"
               << CMD_NOINEDGES << ": detect vertices with no incoming edges\n"
-              << CMD_EDGESTATS << ": print stats on graph edges: e.g., min/max edges per node, etc.\n";
+              << CMD_EDGESTATS << ": print stats on graph edges: e.g., min/max edges per node, etc.\n"
+              << CMD_DEGREESORT << ": relabel vertices by decreasing degree\n"
+              << CMD_RCM << ": relabel vertices in Reverse Cuthill-McKee order\n"
+              << CMD_GORDER << ": relabel vertices with a Gorder-like window heuristic\n"
+              << CMD_COMPRESS << ": binary file to delta/varint compressed binary file conversion\n"
+              << CMD_WEIGHTS << ": add random edge weights to a binary file\n"
+              << CMD_GENERATE << ": write a Graph500 R-MAT graph as a binary file\n";
 }
 
 int main(int argc, char** argv) {
@@ -52,7 +212,7 @@ int main(int argc, char** argv) {
 
         Graph g;
         std::cout << "Loading graph: " << inputFilename << "\n";
-        g = load_graph(inputFilename.c_str());
+        g = load_graph_parallel(inputFilename.c_str());
         std::cout << "Done loading.\n";
         store_graph_binary(outputFilename.c_str(), g);
         delete g;
@@ -265,6 +425,139 @@ int main(int argc, char** argv) {
                   << " max=" << max_incoming << "\n";
     }
 
+    else if (!cmd.compare(CMD_DEGREESORT) || !cmd.compare(CMD_RCM) || !cmd.compare(CMD_GORDER)) {
+
+        if (argc < 5) {
+            std::cerr << "Usage: " << argv[0] << " " << cmd << " binfilename outbinfilename permfilename";
+            if (!cmd.compare(CMD_GORDER))
+                std::cerr << " [window]";
+            std::cerr << "\n";
+            std::cerr << "Writes the relabeled graph and the permutation (new id of every original vertex)\n";
+            exit(1);
+        }
+
+        std::string inputFilename = std::string(argv[2]);
+        std::string outputFilename = std::string(argv[3]);
+        std::string permFilename = std::string(argv[4]);
+
+        Graph g;
+        std::cout << "Loading graph: " << inputFilename << "\n";
+        g = load_graph_binary(inputFilename.c_str());
+        std::cout << "Done loading. Now computing " << cmd << " order...\n";
+
+        std::vector<Vertex> new_id(num_nodes(g));
+        if (!cmd.compare(CMD_DEGREESORT)) {
+            degree_sort_order(g, new_id.data());
+        } else if (!cmd.compare(CMD_RCM)) {
+            rcm_order(g, new_id.data());
+        } else {
+            int window = (argc > 5) ? atoi(argv[5]) : GORDER_DEFAULT_WINDOW;
+            gorder_order(g, new_id.data(), std::max(window, 1));
+        }
+
+        Graph permuted = permute_graph(g, new_id.data());
+        store_graph_binary(outputFilename.c_str(), permuted);
+        store_permutation_binary(permFilename.c_str(), new_id.data(), num_nodes(g));
+        std::cout << "Wrote " << outputFilename << " and " << permFilename << "\n";
+
+        free_graph(permuted);
+        free_graph(g);
+    }
+
+    else if (!cmd.compare(CMD_COMPRESS)) {
+
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " " << cmd << " binfilename compressedfilename [chunk_edges]\n";
+            std::cerr << "Stores sorted, delta-encoded varint adjacency lists and reports the compression ratio\n";
+            std::cerr << "The graph is streamed about chunk_edges edges at a time (default "
+                      << COMPRESS_DEFAULT_CHUNK_EDGES << ")\n";
+            exit(1);
+        }
+
+        std::string inputFilename = std::string(argv[2]);
+        std::string outputFilename = std::string(argv[3]);
+        size_t chunk_edges = (argc > 4) ? std::max(atol(argv[4]), 1L) : COMPRESS_DEFAULT_CHUNK_EDGES;
+
+        std::cout << "Compressing graph: " << inputFilename << "\n";
+
+        int nodes, edges;
+        size_t compressed_bytes = compress_graph_file(inputFilename.c_str(), outputFilename.c_str(),
+                                                      chunk_edges, &nodes, &edges);
+
+        size_t csr_bytes = graph_bytes(nodes, edges);
+        std::cout << "CSR bytes:        " << csr_bytes << "\n";
+        std::cout << "Compressed bytes: " << compressed_bytes << "\n";
+        std::cout << "Ratio:            " << std::setprecision(3)
+                  << static_cast<double>(csr_bytes) / compressed_bytes << "x\n";
+    }
+
+    else if (!cmd.compare(CMD_WEIGHTS)) {
+
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " " << cmd << " binfilename outbinfilename [max_weight] [seed]\n";
+            std::cerr << "Writes a copy of the graph with integer edge weights in [1, max_weight] (default "
+                      << WEIGHTS_DEFAULT_MAX << ")\n";
+            exit(1);
+        }
+
+        std::string inputFilename = std::string(argv[2]);
+        std::string outputFilename = std::string(argv[3]);
+        int max_weight = (argc > 4) ? std::max(atoi(argv[4]), 1) : WEIGHTS_DEFAULT_MAX;
+        unsigned int seed = (argc > 5) ? atoi(argv[5]) : WEIGHTS_DEFAULT_SEED;
+
+        Graph g;
+        std::cout << "Loading graph: " << inputFilename << "\n";
+        g = load_graph_binary(inputFilename.c_str());
+        std::cout << "Done loading. Now assigning weights...\n";
+
+        free(g->outgoing_weights);
+        g->outgoing_weights = (Weight*)malloc(sizeof(Weight) * num_edges(g));
+
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (int u=0; u<num_nodes(g); u++) {
+            const Vertex* begin = outgoing_begin(g, u);
+            for (const Vertex* v=begin; v!=outgoing_end(g, u); v++)
+                g->outgoing_weights[g->outgoing_starts[u] + (v - begin)] = edge_weight(u, *v, max_weight, seed);
+        }
+
+        store_graph_binary(outputFilename.c_str(), g);
+        std::cout << "Wrote " << outputFilename << "\n";
+
+        free_graph(g);
+    }
+
+    else if (!cmd.compare(CMD_GENERATE)) {
+
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " " << cmd << " binfilename scale [edgefactor] [seed]\n";
+            std::cerr << "Writes a symmetric R-MAT graph with 2^scale vertices and about 2 * edgefactor * 2^scale\n"
+                      << "edges (default edgefactor " << GENERATE_DEFAULT_EDGEFACTOR << "). The same arguments give the same\n"
+                      << "file for any number of threads.\n";
+            exit(1);
+        }
+
+        std::string outputFilename = std::string(argv[2]);
+        int scale = atoi(argv[3]);
+        int edgefactor = (argc > 4) ? atoi(argv[4]) : GENERATE_DEFAULT_EDGEFACTOR;
+        unsigned int seed = (argc > 5) ? atoi(argv[5]) : GENERATE_DEFAULT_SEED;
+
+        // vertex ids and edge offsets are ints in the binary format
+        if (scale < 1 || scale > 30 || edgefactor < 1 || 2 * ((long)edgefactor << scale) > INT_MAX) {
+            std::cerr << "scale must be in [1, 30] and 2 * edgefactor * 2^scale at most " << INT_MAX << "\n";
+            exit(1);
+        }
+
+        std::cout << "Generating R-MAT graph: scale " << scale << ", edgefactor " << edgefactor
+                  << ", seed " << seed << "\n";
+        Graph g = generate_rmat(scale, edgefactor, seed);
+        std::cout << "Num vertices: " << num_nodes(g) << "\n";
+        std::cout << "Num edges:    " << num_edges(g) << "\n";
+        store_graph_binary(outputFilename.c_str(), g);
+        std::cout << "Wrote " << outputFilename << "\n";
+
+        free_graph(g);
+    }
+
     else {
         print_help(argv[0]);
     }
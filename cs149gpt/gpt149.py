@@ -4,7 +4,7 @@ import math
 import random
 import inspect
 from dataclasses import dataclass
-import sys, getopt
+import os, sys, getopt
 from os import getcwd, path
 import torch
 import torch.nn as nn
@@ -29,6 +29,10 @@ class CustomAttention(nn.Module):
         self.Q=Q
         self.K=K
         self.V=V
+        # bc, br of 0 are autotuned here rather than inside a timed call; the
+        # reference module runs with the same sizes
+        if bc <= 0 or br <= 0:
+            br, bc = mr.flashBlockSizes(N, d)
         self.bc=bc
         self.br=br
         self.B=B
@@ -62,11 +66,11 @@ class CustomAttention(nn.Module):
         return out
 
     #part 3
-    def myFusedAttention(self):
+    def myFusedAttention(self, is_causal=False):
         if self.isRef:
             with record_function("STUDENT - FUSED ATTENTION"):
                 temp = torch.zeros((NUM_THREADS, self.N))
-                out = mr.myFusedAttention(self.Q, self.K, self.V, temp, self.B, self.H, self.N, self.d)
+                out = mr.myFusedAttention(self.Q, self.K, self.V, temp, self.B, self.H, self.N, self.d, is_causal=is_causal)
             return out
         with record_function("REFERENCE - FUSED ATTENTION"):
             temp = torch.zeros((NUM_THREADS, self.N))
@@ -74,7 +78,7 @@ class CustomAttention(nn.Module):
         return out
 
     #part 4
-    def myFlashAttention(self):
+    def myFlashAttention(self, is_causal=False):
         d = self.d
         Qi = torch.zeros((self.br, self.d))
         Kj = torch.zeros((self.bc, self.d))
@@ -90,7 +94,7 @@ class CustomAttention(nn.Module):
 
         if self.isRef:
             with record_function("STUDENT - FLASH ATTENTION"):
-                out = mr.myFlashAttention(self.Q, self.K, self.V, Qi, Kj, Vj, Sij, Pij, PV, Oi, L, Li, Lij, Lnew, self.bc, self.br, self.B, self.H, self.N, self.d)
+                out = mr.myFlashAttention(self.Q, self.K, self.V, Qi, Kj, Vj, Sij, Pij, PV, Oi, L, Li, Lij, Lnew, self.bc, self.br, self.B, self.H, self.N, self.d, is_causal=is_causal)
             return out
         with record_function("REFERENCE - FLASH ATTENTION"):
             #out = ms.myFlashAttention(self.Q, self.K, self.V, self.B, self.H, self.N, self.d, self.blockSize)
@@ -149,6 +153,15 @@ def badSoftmax(Q, K, V):
     QKV = QKSoftmax @ V   
     return QKV
 
+def causalSoftmax(Q, K, V, group=1):
+    # masked the same way as CausalSelfAttention in model.py; each K/V head
+    # serves group consecutive query heads
+    K, V = K.repeat_interleave(group, dim=1), V.repeat_interleave(group, dim=1)
+    N = Q.size(2)
+    mask = torch.tril(torch.ones(N, N)).view(1, 1, N, N)
+    QK = (Q @ K.transpose(-2, -1)).masked_fill(mask == 0, float('-inf'))
+    return F.softmax(QK, dim=3) @ V
+
 def testTemplate(customFunc, params, test_key):
     start = time.time()
     N, d, B, H = params
@@ -244,6 +257,182 @@ def part4Test(N, d, B, H, bc, br):
     print("-----RUNNING STUDENT IMPLEMENTATION-----\n")
     testTemplate(attentionModuleReference.myFlashAttention, params, "STUDENT - FLASH ATTENTION")
 
+def latencyTest(N, d, B, H, bc, br, iters=3):
+    print("Running Latency Test: end-to-end time of every attention variant\n")
+    # q, k, v laid out as in model.py: (B, N, H, d) storage viewed as (B, H, N, d)
+    Q, K, V = [0.1 * torch.randn(B, N, H, d).transpose(1, 2) for _ in range(3)]
+    QKV = badSoftmax(Q, K, V)
+    for layout, (q, k, v) in (("contiguous", (Q.contiguous(), K.contiguous(), V.contiguous())), ("strided", (Q, K, V))):
+        attentionModule = CustomAttention(q, k, v, B, H, N, d, True, bc, br)
+        variants = (("naive", attentionModule.myUnfusedAttention),
+                    ("blocked", attentionModule.myUnfusedAttentionBlocked),
+                    ("fused", attentionModule.myFusedAttention),
+                    ("flash", attentionModule.myFlashAttention))
+        for name, func in variants:
+            assert torch.allclose(QKV, func(), atol=1e-4), correctness_error_message
+            start = time.time()
+            for _ in range(iters):
+                func()
+            end = time.time()
+            print("N=%-5d %-10s %-8s %9.2f ms" % (N, layout, name, (end - start) * 1000.0 / iters))
+
+def causalTest(N, d, B, H, bc, br):
+    print("Running Causal Test: fused and flash attention with is_causal against PyTorch\n")
+    Q, K, V = [0.5 * torch.randn(B, H, N, d) for _ in range(3)]
+    QKV = causalSoftmax(Q, K, V)
+    attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, bc, br)
+    for name, func in (("fused", attentionModule.myFusedAttention), ("flash", attentionModule.myFlashAttention)):
+        func()  # warm up
+        start = time.time()
+        out = func(is_causal=True)
+        causal_time = time.time() - start
+        start = time.time()
+        func()
+        full_time = time.time() - start
+        assert torch.allclose(QKV, out, atol=1e-4), correctness_error_message
+        print("%-6s causal == pytorch causal: True  (%.2f ms causal, %.2f ms full)" % (name, causal_time * 1000.0, full_time * 1000.0))
+
+def decodeTest(N, d, B, H, prompt=16):
+    print("Running Decode Test: KV-cache decoding against PyTorch causal attention\n")
+    Q, K, V = [0.5 * torch.randn(B, H, N, d) for _ in range(3)]
+    QKV = causalSoftmax(Q, K, V)
+    KCache = torch.zeros((B, H, N, d))
+    VCache = torch.zeros((B, H, N, d))
+    start = time.time()
+    out = [mr.myDecodeAttention(Q[:, :, :prompt], K[:, :, :prompt], V[:, :, :prompt], KCache, VCache, 0, B, H, d)]
+    for pos in range(prompt, N):
+        out.append(mr.myDecodeAttention(Q[:, :, pos:pos + 1], K[:, :, pos:pos + 1], V[:, :, pos:pos + 1], KCache, VCache, pos, B, H, d))
+    elapsed = time.time() - start
+    assert torch.allclose(QKV, torch.cat(out, dim=2), atol=1e-4), correctness_error_message
+    print("decode == pytorch causal attention: True  (%d steps, %.3f ms per step)" % (N - prompt, elapsed * 1000.0 / (N - prompt)))
+
+def accuracyTest(N, d, B, H, bc, br):
+    print("Running Accuracy Test: fused and flash attention at large logit magnitudes\n")
+    for scale in (1.0, 3.0, 6.0):
+        # logits grow as scale^2 * sqrt(d); exp() overflows in float32 past 88
+        Q, K, V = [scale * torch.randn(B, H, N, d) for _ in range(2)] + [torch.randn(B, H, N, d)]
+        QKV = (F.softmax(Q.double() @ K.double().transpose(-2, -1), dim=3) @ V.double()).float()
+        maxLogit = (Q @ K.transpose(-2, -1)).abs().max().item()
+        attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, bc, br)
+        for name, func in (("fused", attentionModule.myFusedAttention), ("flash", attentionModule.myFlashAttention)):
+            out = func()
+            error = (out - QKV).abs().max().item()
+            print("max |logit| %8.1f  %-6s max error %.2e" % (maxLogit, name, error))
+            assert torch.isfinite(out).all() and error < 1e-3, correctness_error_message
+
+def gqaTest(N, d, B, H, bc, br, iters=3):
+    print("Running GQA Test: fused and flash attention with fewer K/V heads than query heads\n")
+    Q = 0.5 * torch.randn(B, H, N, d)
+    Hkv = H
+    while Hkv >= 1:
+        K, V = [0.5 * torch.randn(B, Hkv, N, d) for _ in range(2)]
+        # every K/V head serves H / Hkv consecutive query heads
+        Kr, Vr = K.repeat_interleave(H // Hkv, dim=1), V.repeat_interleave(H // Hkv, dim=1)
+        attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, bc, br)
+        for is_causal in (False, True):
+            QKV = causalSoftmax(Q, K, V, H // Hkv) if is_causal else badSoftmax(Q, Kr, Vr)
+            for name, func in (("fused", attentionModule.myFusedAttention), ("flash", attentionModule.myFlashAttention)):
+                func(is_causal=is_causal)  # warm up
+                start = time.time()
+                for _ in range(iters):
+                    out = func(is_causal=is_causal)
+                elapsed = (time.time() - start) / iters
+                assert torch.allclose(QKV, out, atol=1e-4), correctness_error_message
+                print("H=%d Hkv=%-2d %-6s causal=%-5s == pytorch repeat_interleave: True  (%.2f ms)" % (H, Hkv, name, is_causal, elapsed * 1000.0))
+        Hkv //= 2
+
+def quantizedTest(N, d, B, H, bc, br, iters=3):
+    print("Running Quantized Test: flash attention over bf16 and int8 K/V\n")
+    Q, K, V = [0.5 * torch.randn(B, H, N, d) for _ in range(3)]
+    QKV = (F.softmax(Q.double() @ K.double().transpose(-2, -1), dim=3) @ V.double()).float()
+    attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, bc, br)
+    attentionModule.myFlashAttention()  # warm up
+    start = time.time()
+    for _ in range(iters):
+        out = attentionModule.myFlashAttention()
+    fp32_time = (time.time() - start) / iters
+    print("N=%-5d fp32  max error %.2e  %9.2f ms" % (N, (out - QKV).abs().max().item(), fp32_time * 1000.0))
+    for fmt, tolerance in (("bf16", 2e-2), ("int8", 3e-2)):
+        Kq, Ks = mr.quantizeKV(K, fmt)
+        Vq, Vs = mr.quantizeKV(V, fmt)
+        start = time.time()
+        for _ in range(iters):
+            out = mr.myFlashAttentionQuantized(Q, Kq, Ks, Vq, Vs, fmt, attentionModule.bc, attentionModule.br, B, H, N, d)
+        elapsed = (time.time() - start) / iters
+        error = (out - QKV).abs().max().item()
+        print("N=%-5d %s  max error %.2e  %9.2f ms  %5.2fx" % (N, fmt, error, elapsed * 1000.0, fp32_time / elapsed))
+        assert error < tolerance, correctness_error_message
+
+def autotuneTest(N, d, B, H, iters=3):
+    print("Running Autotune Test: flash attention with tuned block sizes against 256 x 256\n")
+    Q, K, V = [0.1 * torch.randn(B, H, N, d) for _ in range(3)]
+    QKV = badSoftmax(Q, K, V)
+    start = time.time()
+    br, bc = mr.flashBlockSizes(N, d)
+    print("N=%d d=%d: Br=%d Bc=%d (%.2f s to tune or load)" % (N, d, br, bc, time.time() - start))
+    for label, blocks in (("autotuned", 0), ("256 x 256", 256)):
+        attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, blocks, blocks)
+        assert torch.allclose(QKV, attentionModule.myFlashAttention(), atol=1e-4), correctness_error_message
+        start = time.time()
+        for _ in range(iters):
+            attentionModule.myFlashAttention()
+        print("%-10s %9.2f ms" % (label, (time.time() - start) * 1000.0 / iters))
+
+def backwardTest(N, d, B, H, bc, br):
+    print("Running Backward Test: flash attention gradients against PyTorch autograd\n")
+    from model import FlashAttentionFunction
+    for n, hkv, is_causal in ((77, H, False), (77, H, True), (N, H, True), (N, H // 2, True)):
+        Q = 0.5 * torch.randn(B, H, n, d)
+        K, V = [0.5 * torch.randn(B, hkv, n, d) for _ in range(2)]
+        dO = torch.randn(B, H, n, d)
+        q, k, v = [t.clone().requires_grad_() for t in (Q, K, V)]
+        if bc <= 0 or br <= 0:
+            mr.flashBlockSizes(n, d)  # tune outside the timed region
+        start = time.time()
+        FlashAttentionFunction.apply(q, k, v, is_causal, bc, br).backward(dO)
+        flash_time = time.time() - start
+        # autograd through the materialized attention, in float64
+        qr, kr, vr = [t.double().requires_grad_() for t in (Q, K, V)]
+        start = time.time()
+        if is_causal:
+            out = causalSoftmax(qr, kr, vr, H // hkv)
+        else:
+            out = badSoftmax(qr, kr.repeat_interleave(H // hkv, dim=1), vr.repeat_interleave(H // hkv, dim=1))
+        out.backward(dO.double())
+        autograd_time = time.time() - start
+        for name, grad, expected in (("dQ", q.grad, qr.grad), ("dK", k.grad, kr.grad), ("dV", v.grad, vr.grad)):
+            error = (grad.double() - expected).abs().max().item()
+            assert error < 1e-3, correctness_error_message
+        print("N=%-5d Hkv=%d causal=%-5s dQ, dK, dV == autograd: True  (%.2f ms flash, %.2f ms autograd float64)" %
+              (n, hkv, is_causal, flash_time * 1000.0, autograd_time * 1000.0))
+    # finite differences on a small problem; float32 needs a loose tolerance
+    q, k, v = [(0.5 * torch.randn(1, 2, 9, 8)).requires_grad_() for _ in range(3)]
+    assert torch.autograd.gradcheck(lambda q, k, v: FlashAttentionFunction.apply(q, k, v, True, bc, br), (q, k, v),
+                                    eps=1e-2, atol=1e-2, rtol=1e-2, nondet_tol=1e-5), correctness_error_message
+    print("gradcheck (float32, tolerance 1e-2): True")
+
+def scalingTest(N, d, B, H, bc, br, iters=3):
+    print("Running Scaling Test: flash attention from 1 thread to every core\n")
+    Q, K, V = [0.1 * torch.randn(B, H, N, d) for _ in range(3)]
+    QKV = badSoftmax(Q, K, V)
+    attentionModule = CustomAttention(Q, K, V, B, H, N, d, True, bc, br)
+    threads = [1]
+    while threads[-1] * 2 < os.cpu_count():
+        threads.append(threads[-1] * 2)
+    if threads[-1] != os.cpu_count():
+        threads.append(os.cpu_count())
+    base = None
+    for t in threads:
+        torch.set_num_threads(t)
+        assert torch.allclose(QKV, attentionModule.myFlashAttention(), atol=1e-4), correctness_error_message
+        start = time.time()
+        for _ in range(iters):
+            attentionModule.myFlashAttention()
+        elapsed = (time.time() - start) / iters
+        base = base or elapsed
+        print("%3d threads: %9.2f ms  %5.2fx" % (t, elapsed * 1000.0, base / elapsed))
+    torch.set_num_threads(NUM_THREADS)
+
 def accessTest(B, H, N, d):
     Q,_ ,_ = createQKVSimple(N,d,B,H)
     print("\nTensor Shape:", Q.size())
@@ -266,11 +455,12 @@ def main():
     H=4
     
     parser = argparse.ArgumentParser()
-    parser.add_argument("testname", default="part0", help="name of test to run: part0, part1, part2, part3, part4, 4Daccess")
+    parser.add_argument("testname", default="part0", help="name of test to run: part0, part1, part2, part3, part4, latency, scaling, accuracy, causal, decode, quantized, gqa, autotune, backward, 4Daccess")
     parser.add_argument("-m", "--model", default="shakes128", help="name of model to use: shakes128, shakes1024, shakes2048, kayvon")
     parser.add_argument("--inference", action="store_true", default=False, help="run gpt inference")
-    parser.add_argument("-bc",  default="256", help="Flash Attention Bc Size")
-    parser.add_argument("-br", default="256", help="Flash Attention Br Size")
+    parser.add_argument("--kv-cache", action="store_true", default=False, help="with --inference, decode with the KV-cache kernel")
+    parser.add_argument("-bc",  default="0", help="Flash Attention Bc Size (0 to autotune)")
+    parser.add_argument("-br", default="0", help="Flash Attention Br Size (0 to autotune)")
     parser.add_argument("-N", default="1024", help="Flash Attention Br Size")
 
     args = parser.parse_args()
@@ -303,6 +493,24 @@ def main():
             part3Test(N, d, B, H)
         elif args.testname == "part4":
             part4Test(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "latency":
+            latencyTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "causal":
+            causalTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "decode":
+            decodeTest(N, d, B, H)
+        elif args.testname == "accuracy":
+            accuracyTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "backward":
+            backwardTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "autotune":
+            autotuneTest(N, d, B, H)
+        elif args.testname == "gqa":
+            gqaTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "quantized":
+            quantizedTest(N, d, B, H, int(args.bc), int(args.br))
+        elif args.testname == "scaling":
+            scalingTest(N, d, B, H, int(args.bc), int(args.br))
         elif args.testname == "4Daccess":
             accessTest(1, 2, 4, 4)
         else:
@@ -310,7 +518,7 @@ def main():
     else:
         print("Running inference using dnn model %s" % (args.model))
         from sample import run_sample
-        run_sample(N, model_filename, args.testname)
+        run_sample(N, model_filename, args.testname, args.kv_cache)
 
         
 if __name__ == "__main__":
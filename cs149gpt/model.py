@@ -24,6 +24,30 @@ ispc_path = getcwd() + "/module_ispc.o"
 if not path.exists(ispc_path): ispc_path = ""
 ms = load(name="custom_module", sources=["module.cpp"],  extra_cflags=["-mavx", "-O3", "-fopenmp"], extra_ldflags=[ispc_path])
 correctness_error_message = "\n-------------------------------------------\n YOUR ATTENTION PRODUCED INCORRECT RESULTS"
+
+class FlashAttentionFunction(torch.autograd.Function):
+    """ Attention through the flash kernels of module.cpp. Only the output and the
+    logsumexp of each row of scores are saved; the backward kernel recomputes the
+    probabilities block by block, so no (T, T) matrix is ever kept. """
+
+    @staticmethod
+    def forward(ctx, q, k, v, is_causal, bc=0, br=0):
+        B, H, N, d = q.size()
+        # block sizes of 0 are autotuned for (N, d)
+        y, lse = ms.myFlashAttentionForward(q, k, v, bc, br, B, H, N, d, is_causal=is_causal)
+        ctx.save_for_backward(q, k, v, y, lse)
+        ctx.is_causal = is_causal
+        ctx.bc, ctx.br = bc, br
+        return y
+
+    @staticmethod
+    def backward(ctx, dy):
+        q, k, v, y, lse = ctx.saved_tensors
+        B, H, N, d = q.size()
+        dq, dk, dv = ms.myFlashAttentionBackward(q, k, v, y, dy, lse, ctx.bc, ctx.br, B, H, N, d,
+                                                 is_causal=ctx.is_causal)
+        return dq, dk, dv, None, None, None
+
 class LayerNorm(nn.Module):
     """ LayerNorm but with an optional bias. PyTorch doesn't support simply bias=False """
 
@@ -62,8 +86,11 @@ class CausalSelfAttention(nn.Module):
                                         .view(1, 1, config.block_size, config.block_size))
         self.custom_attn_inference_time = 0
         self.python_inference_time = 0
+        # (B, nh, block_size, hs) keys and values of the tokens decoded so far
+        self.k_cache = None
+        self.v_cache = None
 
-    def forward(self, x):
+    def forward(self, x, cache_pos=None):
         B, T, C = x.size() # batch size, sequence length, embedding dimensionality (n_embd)
 
         # calculate query, key, values for all heads in batch and move head forward to be the batch dim
@@ -75,7 +102,31 @@ class CausalSelfAttention(nn.Module):
         H = self.n_head
         d = C // self.n_head
         # causal self-attention; Self-attend: (B, nh, T, hs) x (B, nh, hs, T) -> (B, nh, T, T)
-        if self.flash:
+        if cache_pos is not None:
+            # incremental decoding: the T new tokens sit at positions cache_pos.., their
+            # k, v are appended to this layer's cache and attend to everything before
+            if self.k_cache is None or self.k_cache.size(0) != B or self.k_cache.dtype != q.dtype \
+                    or self.k_cache.device != q.device:
+                self.k_cache = torch.zeros((B, H, self.block_size, d), dtype=q.dtype, device=q.device)
+                self.v_cache = torch.zeros((B, H, self.block_size, d), dtype=q.dtype, device=q.device)
+            start_time = time.time()
+            if q.device.type == 'cpu' and q.dtype == torch.float32:
+                # module.cpp's kernels only read host memory and float32
+                y = ms.myDecodeAttention(q, k, v, self.k_cache, self.v_cache, cache_pos, B, H, d)
+            else:
+                end = cache_pos + T
+                self.k_cache[:, :, cache_pos:end] = k
+                self.v_cache[:, :, cache_pos:end] = v
+                att = q @ self.k_cache[:, :, :end].transpose(-2, -1)
+                att = att.masked_fill(self.bias[:,:,cache_pos:end,:end] == 0, float('-inf'))
+                y = F.softmax(att, dim=-1) @ self.v_cache[:, :, :end]
+            self.custom_attn_inference_time += time.time() - start_time
+        elif self.training and self.dropout == 0.0 and torch.is_grad_enabled() and q.device.type == 'cpu':
+            # training on CPU: causal flash attention forward and backward from
+            # module.cpp, whose kernels only read host memory; other devices and
+            # dropout on the attention probabilities take the paths below
+            y = FlashAttentionFunction.apply(q, k, v, True)
+        elif self.flash:
             # efficient attention using Flash Attention CUDA kernels
             y = torch.nn.functional.scaled_dot_product_attention(q, k, v, attn_mask=None, dropout_p=self.dropout if self.training else 0, is_causal=True)
         else:
@@ -93,6 +144,7 @@ class CausalSelfAttention(nn.Module):
             y_comp = attS_no_mask @ v
 
             #c++ flash attention
+            expected = y_comp
             start_time = time.time()  # Store start time
             if self.testname == "part0":
                 att2 = y_comp
@@ -122,13 +174,18 @@ class CausalSelfAttention(nn.Module):
                 Lnew = torch.zeros((bs))
                 Lij = torch.zeros((bs))
                 Li = torch.zeros((bs))
-                att2 = ms.myFlashAttention(q, k, v, Qi, Kj, Vj, Sij, Pij, PV, Oi, L, Li, Lij, Lnew, bs, bs, B, H, N, d)
+                # masked like y, so the kernel skips the tiles above the diagonal;
+                # explicit block sizes, so no autotuning runs inside the timed region
+                att2 = ms.myFlashAttention(q, k, v, Qi, Kj, Vj, Sij, Pij, PV, Oi, L, Li, Lij, Lnew, bs, bs, B, H, N, d, is_causal=True)
+                expected = y
             else:
                 print("Unknown test name: %s" % self.testname)
             
             end_time = time.time()  # Store start time
             self.custom_attn_inference_time += end_time - start_time
-            assert torch.allclose(y_comp, att2, atol=1e-02,), correctness_error_message
+            assert torch.allclose(expected, att2, atol=1e-02,), correctness_error_message
+            if self.testname == "part4":
+                y = att2
 
         y = y.transpose(1, 2).contiguous().view(B, T, C) # re-assemble all head outputs side by side
         y = self.resid_dropout(self.c_proj(y))
@@ -159,8 +216,8 @@ class Block(nn.Module):
         self.ln_2 = LayerNorm(config.n_embd, bias=config.bias)
         self.mlp = MLP(config)
 
-    def forward(self, x):
-        x = x + self.attn(self.ln_1(x))
+    def forward(self, x, cache_pos=None):
+        x = x + self.attn(self.ln_1(x), cache_pos)
         x = x + self.mlp(self.ln_2(x))
         return x
 
@@ -229,11 +286,16 @@ class GPT(nn.Module):
         elif isinstance(module, nn.Embedding):
             torch.nn.init.normal_(module.weight, mean=0.0, std=0.02)
 
-    def forward(self, idx, targets=None):
+    def forward(self, idx, targets=None, cache_pos=None):
+        """
+        With cache_pos, idx holds the tokens at positions cache_pos.. of a sequence whose
+        earlier tokens are in the attention layers' KV caches, and they are added to them.
+        """
         device = idx.device
         b, t = idx.size()
-        assert t <= self.config.block_size, f"Cannot forward sequence of length {t}, block size is only {self.config.block_size}"
-        pos = torch.arange(0, t, dtype=torch.long, device=device) # shape (t)
+        start = 0 if cache_pos is None else cache_pos
+        assert start + t <= self.config.block_size, f"Cannot forward sequence of length {start + t}, block size is only {self.config.block_size}"
+        pos = torch.arange(start, start + t, dtype=torch.long, device=device) # shape (t)
         # forward the GPT model itself
         tok_emb = self.transformer.wte(idx) # token embeddings of shape (b, t, n_embd)
         pos_emb = self.transformer.wpe(pos) # position embeddings of shape (t, n_embd)
@@ -241,7 +303,7 @@ class GPT(nn.Module):
         
         self.forward_times += 1
         for block in self.transformer.h:
-            x = block(x)
+            x = block(x, cache_pos)
         x = self.transformer.ln_f(x)
 
         if targets is not None:
@@ -366,17 +428,30 @@ class GPT(nn.Module):
         return mfu
 
     @torch.no_grad()
-    def generate(self, idx, max_new_tokens, decode, temperature=1.0, top_k=None):
+    def generate(self, idx, max_new_tokens, decode, temperature=1.0, top_k=None, use_kv_cache=False):
         """
         Take a conditioning sequence of indices idx (LongTensor of shape (b,t)) and complete
         the sequence max_new_tokens times, feeding the predictions back into the model each time.
         Most likely you'll want to make sure to be in model.eval() mode of operation for this.
+        With use_kv_cache, only the newest token goes through the model at each step and
+        attends to the keys and values cached for the earlier ones.
         """
+        cache_pos = None
         for _ in range(max_new_tokens):
-            # if the sequence context is growing too long we must crop it at block_size
-            idx_cond = idx if idx.size(1) <= self.config.block_size else idx[:, -self.config.block_size:]
-            # forward the model to get the logits for the index in the sequence
-            logits, _ = self(idx_cond)
+            if use_kv_cache and cache_pos is not None and cache_pos < self.config.block_size:
+                logits, _ = self(idx[:, -1:], cache_pos=cache_pos)
+                cache_pos += 1
+            else:
+                # if the sequence context is growing too long we must crop it at block_size
+                idx_cond = idx if idx.size(1) <= self.config.block_size else idx[:, -self.config.block_size:]
+                # forward the model to get the logits for the index in the sequence
+                if use_kv_cache:
+                    # (re)fill the caches; once the context is cropped every position
+                    # shifts, so this happens on every step from then on
+                    logits, _ = self(idx_cond, cache_pos=0)
+                    cache_pos = idx_cond.size(1)
+                else:
+                    logits, _ = self(idx_cond)
             # pluck the logits at the final step and scale by desired temperature
             logits = logits[:, -1, :] / temperature
             # optionally crop the logits to only the top k options
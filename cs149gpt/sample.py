@@ -2,13 +2,14 @@
 Sample from a trained model
 """
 import os
+import time
 import pickle
 from contextlib import nullcontext
 import torch
 import tiktoken
 from model import GPTConfig, GPT
 
-def run_sample(N, out_dir, testname):
+def run_sample(N, out_dir, testname, kv_cache=False):
     # -----------------------------------------------------------------------------
     init_from = 'resume' # either 'resume' (from an out_dir) or a gpt2 variant (e.g. 'gpt2-xl')
     # out_dir = 'out' # ignored if init_from is not 'resume'
@@ -90,9 +91,12 @@ def run_sample(N, out_dir, testname):
     with torch.no_grad():
         with ctx:
             for k in range(num_samples):
-                y = model.generate(x, max_new_tokens, decode, temperature=temperature, top_k=top_k)
+                start_time = time.time()
+                y = model.generate(x, max_new_tokens, decode, temperature=temperature, top_k=top_k, use_kv_cache=kv_cache)
+                elapsed = time.time() - start_time
                 #print(decode(y[0].tolist()))
                 print('\n-------------------------------------------------------------')
+                print(f"{max_new_tokens} tokens in {elapsed:.2f}s: {max_new_tokens / elapsed:.1f} tokens/sec" + (" (KV cache)" if kv_cache else ""))
 
                 #custom_attn_inference_time = 0
                 #python_inference_time = 0